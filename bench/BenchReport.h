@@ -0,0 +1,86 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_BENCHREPORT_H
+#define THREADPOOLLIB_BENCHREPORT_H
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Collects benchmark measurements and writes them as CSV or JSON.
+ *
+ * Every measurement is a flat row, so that results of different releases can be
+ * diffed or joined on (scenario, variant, threads, metric).
+ */
+class BenchReport {
+
+public:
+    struct Row {
+        std::string scenario;
+        std::string variant;
+        unsigned int threads;
+        std::string metric;
+        double value;
+        std::string unit;
+    };
+
+    void Add(const std::string& scenario, const std::string& variant, unsigned int threads,
+             const std::string& metric, double value, const std::string& unit){
+        rows_.push_back(Row{scenario, variant, threads, metric, value, unit});
+        std::fprintf(stderr, "%-12s %-14s %3u threads  %-12s %14.3f %s\n",
+                     scenario.c_str(), variant.c_str(), threads, metric.c_str(), value, unit.c_str());
+    }
+
+    void WriteCsv(std::FILE* out) const {
+        std::fprintf(out, "scenario,variant,threads,metric,value,unit\n");
+        for(const Row& row : rows_)
+            std::fprintf(out, "%s,%s,%u,%s,%.6f,%s\n", row.scenario.c_str(), row.variant.c_str(),
+                         row.threads, row.metric.c_str(), row.value, row.unit.c_str());
+    }
+
+    void WriteJson(std::FILE* out) const {
+        std::fprintf(out, "[\n");
+        for(std::size_t i = 0; i < rows_.size(); i++){
+            const Row& row = rows_[i];
+            std::fprintf(out, "  {\"scenario\": \"%s\", \"variant\": \"%s\", \"threads\": %u, "
+                              "\"metric\": \"%s\", \"value\": %.6f, \"unit\": \"%s\"}%s\n",
+                         row.scenario.c_str(), row.variant.c_str(), row.threads, row.metric.c_str(),
+                         row.value, row.unit.c_str(), i + 1 < rows_.size() ? "," : "");
+        }
+        std::fprintf(out, "]\n");
+    }
+
+    /**
+     * Percentile (0..1) of an already sorted sample.
+     */
+    static double Percentile(const std::vector<double>& sorted, double p){
+        if(sorted.empty())
+            return 0.0;
+        return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+    }
+
+private:
+    std::vector<Row> rows_;
+};
+
+#endif //THREADPOOLLIB_BENCHREPORT_H
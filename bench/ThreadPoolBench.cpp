@@ -0,0 +1,385 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "TaskGroup.h"
+#include "BenchReport.h"
+
+/**
+ * ThreadPoolLib benchmark suite.
+ *
+ * Usage: threadpool_bench [--scenario NAME] [--threads N] [--scale F] [--format csv|json] [--output FILE]
+ *
+ * Scenarios: throughput, latency, fanout, forkjoin, mixed, scaling (all of them by default).
+ * --scale multiplies the amount of work of every scenario (e.g. 0.1 for a smoke run).
+ * Human readable progress goes to stderr, the report to stdout or to --output.
+ */
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    struct BenchConfig {
+        std::string scenario = "all";
+        unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+        double scale = 1.0;
+        std::string format = "csv";
+        std::string output;
+    };
+
+    double Seconds(Clock::duration duration){
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    double Micros(Clock::duration duration){
+        return std::chrono::duration<double, std::micro>(duration).count();
+    }
+
+    double ProcessCpuSeconds(){
+        timespec ts{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+    }
+
+    // Busy work of roughly the given duration, without touching shared memory.
+    void Work(std::chrono::nanoseconds duration){
+        Clock::time_point end = Clock::now() + duration;
+        while(Clock::now() < end)
+            CPU_RELAX();
+    }
+
+    std::size_t Scaled(const BenchConfig& config, std::size_t amount){
+        return std::max<std::size_t>(1, static_cast<std::size_t>(amount * config.scale));
+    }
+
+    void WaitFor(const std::atomic<std::size_t>& counter, std::size_t target){
+        while(counter.load(std::memory_order_acquire) < target)
+            std::this_thread::yield();
+    }
+
+    /**
+     * Empty tasks per second, through the different submission paths.
+     */
+    void Throughput(const BenchConfig& config, BenchReport& report){
+        const std::size_t tasks = Scaled(config, 500000);
+        ThreadPool pool(ThreadPoolOptions{.threads = config.threads});
+        std::atomic<std::size_t> done{0};
+        auto empty = [&done](){ done.fetch_add(1, std::memory_order_relaxed); };
+
+        Clock::time_point start = Clock::now();
+        for(std::size_t i = 0; i < tasks; i++)
+            pool.CreateTask(empty);
+        WaitFor(done, tasks);
+        report.Add("throughput", "create_task", config.threads, "tasks_per_s", tasks / Seconds(Clock::now() - start), "1/s");
+
+        start = Clock::now();
+        pool.SubmitBatch(tasks, [](std::size_t){}).Wait();
+        report.Add("throughput", "submit_batch", config.threads, "tasks_per_s", tasks / Seconds(Clock::now() - start), "1/s");
+
+        // Submitted from within a worker: local deque plus stealing.
+        done = 0;
+        start = Clock::now();
+        pool.Submit([&pool, &empty, tasks](){
+            for(std::size_t i = 0; i < tasks; i++)
+                pool.CreateTask(empty);
+        }).get();
+        WaitFor(done, tasks);
+        report.Add("throughput", "from_worker", config.threads, "tasks_per_s", tasks / Seconds(Clock::now() - start), "1/s");
+
+        // The same submissions again, now that the slabs are warm: they should not reach the global heap.
+        AllocationStats warm = pool.GetAllocationStats();
+        done = 0;
+        for(std::size_t i = 0; i < tasks; i++)
+            pool.CreateTask(empty);
+        WaitFor(done, tasks);
+        AllocationStats steady = pool.GetAllocationStats();
+        report.Add("throughput", "allocations", config.threads, "heap_allocs",
+                   static_cast<double>(steady.heapAllocations - warm.heapAllocations), "count");
+
+        // External submissions again, through the lock-free shared queues.
+        {
+            ThreadPool lockFree(ThreadPoolOptions{.threads = config.threads, .queueBackend = QUEUE_LOCK_FREE});
+            done = 0;
+            start = Clock::now();
+            for(std::size_t i = 0; i < tasks; i++)
+                lockFree.CreateTask(empty);
+            WaitFor(done, tasks);
+            report.Add("throughput", "create_task_lock_free", config.threads, "tasks_per_s", tasks / Seconds(Clock::now() - start), "1/s");
+        }
+    }
+
+    /**
+     * Submit-to-start latency of isolated tasks (workers idle before every submission),
+     * and CPU burnt meanwhile, for every idle policy.
+     */
+    void Latency(const BenchConfig& config, BenchReport& report){
+        const std::size_t samples = Scaled(config, 5000);
+        const std::pair<const char*, IdlePolicy> policies[] = {
+            {"park", IDLE_PARK}, {"spin", IDLE_SPIN}, {"adaptive", IDLE_ADAPTIVE}
+        };
+
+        for(const auto& [name, policy] : policies){
+            ThreadPool pool(ThreadPoolOptions{.threads = config.threads, .idlePolicy = policy});
+            std::vector<double> latencies;
+            latencies.reserve(samples);
+
+            double cpuStart = ProcessCpuSeconds();
+            Clock::time_point wallStart = Clock::now();
+            for(std::size_t i = 0; i < samples; i++){
+                Clock::time_point submitted = Clock::now();
+                TaskFuture<Clock::time_point> started = pool.Submit([](){ return Clock::now(); });
+                latencies.push_back(Micros(started.get() - submitted));
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            double cores = (ProcessCpuSeconds() - cpuStart) / Seconds(Clock::now() - wallStart);
+
+            std::sort(latencies.begin(), latencies.end());
+            report.Add("latency", name, config.threads, "p50", BenchReport::Percentile(latencies, 0.50), "us");
+            report.Add("latency", name, config.threads, "p99", BenchReport::Percentile(latencies, 0.99), "us");
+            report.Add("latency", name, config.threads, "p999", BenchReport::Percentile(latencies, 0.999), "us");
+            report.Add("latency", name, config.threads, "cpu", cores, "cores");
+        }
+    }
+
+    /**
+     * One producer fans out a wave of small tasks and waits for all of them (fan-in).
+     */
+    void FanOut(const BenchConfig& config, BenchReport& report){
+        const std::size_t rounds = Scaled(config, 200);
+        const std::size_t width = 1000;
+        ThreadPool pool(ThreadPoolOptions{.threads = config.threads});
+
+        std::vector<double> rounds_us;
+        std::atomic<std::size_t> done{0};
+        auto child = [&done](){
+            Work(std::chrono::nanoseconds(500));
+            done.fetch_add(1, std::memory_order_release);
+        };
+        for(std::size_t round = 0; round < rounds; round++){
+            Clock::time_point start = Clock::now();
+            for(std::size_t i = 0; i < width; i++)
+                pool.CreateTask(child);
+            WaitFor(done, (round + 1) * width);
+            rounds_us.push_back(Micros(Clock::now() - start));
+        }
+        std::sort(rounds_us.begin(), rounds_us.end());
+        report.Add("fanout", "create_task", config.threads, "p50", BenchReport::Percentile(rounds_us, 0.50), "us");
+        report.Add("fanout", "create_task", config.threads, "p99", BenchReport::Percentile(rounds_us, 0.99), "us");
+
+        rounds_us.clear();
+        for(std::size_t round = 0; round < rounds; round++){
+            Clock::time_point start = Clock::now();
+            pool.SubmitBatch(width, [](std::size_t){ Work(std::chrono::nanoseconds(500)); }).Wait();
+            rounds_us.push_back(Micros(Clock::now() - start));
+        }
+        std::sort(rounds_us.begin(), rounds_us.end());
+        report.Add("fanout", "submit_batch", config.threads, "p50", BenchReport::Percentile(rounds_us, 0.50), "us");
+        report.Add("fanout", "submit_batch", config.threads, "p99", BenchReport::Percentile(rounds_us, 0.99), "us");
+    }
+
+    long Fibonacci(ThreadPool& pool, int n){
+        if(n < 12){
+            long a = 0, b = 1;
+            for(int i = 0; i < n; i++){
+                long next = a + b;
+                a = b;
+                b = next;
+            }
+            return a;
+        }
+        TaskFuture<long> left = pool.Submit(Fibonacci, std::ref(pool), n - 1);
+        long right = Fibonacci(pool, n - 2);
+        return left.get() + right;
+    }
+
+    // Same recursion, forked through a TaskGroup instead of a future per level.
+    long GroupFibonacci(ThreadPool& pool, int n){
+        if(n < 12)
+            return Fibonacci(pool, n);
+        long left;
+        TaskGroup group(pool);
+        group.Run([&pool, &left, n]{ left = GroupFibonacci(pool, n - 1); });
+        long right = GroupFibonacci(pool, n - 2);
+        group.Wait();
+        return left + right;
+    }
+
+    /**
+     * Recursive divide and conquer: every level forks one half and computes the other.
+     */
+    void ForkJoin(const BenchConfig& config, BenchReport& report){
+        const int depth = config.scale < 0.5 ? 24 : 30;
+        ThreadPool pool(ThreadPoolOptions{.threads = config.threads});
+
+        Clock::time_point start = Clock::now();
+        long result = pool.Submit(Fibonacci, std::ref(pool), depth).get();
+        double elapsed = Seconds(Clock::now() - start);
+
+        if(result <= 0)
+            std::fprintf(stderr, "forkjoin: unexpected result %ld\n", result);
+        report.Add("forkjoin", "fib" + std::to_string(depth), config.threads, "time", elapsed * 1e3, "ms");
+
+        start = Clock::now();
+        result = GroupFibonacci(pool, depth);
+        elapsed = Seconds(Clock::now() - start);
+
+        if(result <= 0)
+            std::fprintf(stderr, "forkjoin: unexpected result %ld\n", result);
+        report.Add("forkjoin", "task_group_fib" + std::to_string(depth), config.threads, "time", elapsed * 1e3, "ms");
+    }
+
+    /**
+     * Mostly short tasks with a few long ones in between: how much do the long ones
+     * delay the short ones?
+     */
+    void Mixed(const BenchConfig& config, BenchReport& report){
+        const std::size_t tasks = Scaled(config, 20000);
+        ThreadPool pool(ThreadPoolOptions{.threads = config.threads});
+
+        std::vector<TaskFuture<double>> shortTasks;
+        std::vector<TaskFuture<double>> longTasks;
+        shortTasks.reserve(tasks);
+
+        Clock::time_point start = Clock::now();
+        for(std::size_t i = 0; i < tasks; i++){
+            Clock::time_point submitted = Clock::now();
+            bool isLong = i % 50 == 0;
+            auto task = [submitted, isLong](){
+                double waited = Micros(Clock::now() - submitted);
+                Work(isLong ? std::chrono::nanoseconds(500000) : std::chrono::nanoseconds(2000));
+                return waited;
+            };
+            (isLong ? longTasks : shortTasks).push_back(pool.Submit(task));
+        }
+
+        std::vector<double> waits;
+        waits.reserve(shortTasks.size());
+        for(TaskFuture<double>& future : shortTasks)
+            waits.push_back(future.get());
+        for(TaskFuture<double>& future : longTasks)
+            future.get();
+        double elapsed = Seconds(Clock::now() - start);
+
+        std::sort(waits.begin(), waits.end());
+        report.Add("mixed", "2us+500us", config.threads, "time", elapsed * 1e3, "ms");
+        report.Add("mixed", "2us+500us", config.threads, "short_wait_p50", BenchReport::Percentile(waits, 0.50), "us");
+        report.Add("mixed", "2us+500us", config.threads, "short_wait_p99", BenchReport::Percentile(waits, 0.99), "us");
+    }
+
+    /**
+     * Fine-grained (~1us) tasks with 1, 2, 4... up to --threads workers.
+     */
+    void Scaling(const BenchConfig& config, BenchReport& report){
+        const std::size_t tasks = Scaled(config, 200000);
+        double baseline = 0.0;
+
+        for(unsigned int threads = 1; ; threads = std::min(threads * 2, config.threads)){
+            ThreadPool pool(ThreadPoolOptions{.threads = threads});
+
+            Clock::time_point start = Clock::now();
+            pool.Submit([&pool, tasks](){
+                pool.SubmitBatch(tasks, [](std::size_t){ Work(std::chrono::nanoseconds(1000)); }).Wait();
+            }).get();
+            double throughput = tasks / Seconds(Clock::now() - start);
+
+            if(threads == 1)
+                baseline = throughput;
+            report.Add("scaling", "1us_tasks", threads, "tasks_per_s", throughput, "1/s");
+            report.Add("scaling", "1us_tasks", threads, "speedup", throughput / baseline, "x");
+
+            if(threads == config.threads)
+                break;
+        }
+    }
+
+    bool ParseArguments(int argc, char** argv, BenchConfig& config){
+        for(int i = 1; i < argc; i++){
+            std::string argument = argv[i];
+            bool hasValue = i + 1 < argc;
+            if(argument == "--scenario" && hasValue)
+                config.scenario = argv[++i];
+            else if(argument == "--threads" && hasValue)
+                config.threads = std::max(1, std::atoi(argv[++i]));
+            else if(argument == "--scale" && hasValue)
+                config.scale = std::atof(argv[++i]);
+            else if(argument == "--format" && hasValue)
+                config.format = argv[++i];
+            else if(argument == "--output" && hasValue)
+                config.output = argv[++i];
+            else
+                return false;
+        }
+        return config.format == "csv" || config.format == "json";
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if(!ParseArguments(argc, argv, config)){
+        std::fprintf(stderr, "Usage: %s [--scenario throughput|latency|fanout|forkjoin|mixed|scaling|all]"
+                             " [--threads N] [--scale F] [--format csv|json] [--output FILE]\n", argv[0]);
+        return 1;
+    }
+
+    const std::pair<const char*, std::function<void(const BenchConfig&, BenchReport&)>> scenarios[] = {
+        {"throughput", Throughput},
+        {"latency", Latency},
+        {"fanout", FanOut},
+        {"forkjoin", ForkJoin},
+        {"mixed", Mixed},
+        {"scaling", Scaling}
+    };
+
+    BenchReport report;
+    bool found = false;
+    for(const auto& [name, scenario] : scenarios){
+        if(config.scenario == "all" || config.scenario == name){
+            scenario(config, report);
+            found = true;
+        }
+    }
+    if(!found){
+        std::fprintf(stderr, "Unknown scenario: %s\n", config.scenario.c_str());
+        return 1;
+    }
+
+    std::FILE* out = config.output.empty() ? stdout : std::fopen(config.output.c_str(), "w");
+    if(!out){
+        std::fprintf(stderr, "Can not open %s\n", config.output.c_str());
+        return 1;
+    }
+    if(config.format == "json")
+        report.WriteJson(out);
+    else
+        report.WriteCsv(out);
+    if(out != stdout)
+        std::fclose(out);
+
+    return 0;
+}
@@ -21,8 +21,23 @@
 #include <iostream>
 #include <tuple>
 #include "ThreadPool.h"
+#include "Coroutine.h"
 #include "Foo.h"
 #include "Task.h"
+#include "TaskGraph.h"
+
+/**
+ * Coroutines for Example 7.
+ */
+pool::Task<int> DoubleOnPool(ThreadPool& pool, int value) {
+    co_await pool.Schedule();
+    co_return value * 2;
+}
+
+pool::Task<int> AddOneToDouble(ThreadPool& pool, int value) {
+    int doubled = co_await DoubleOnPool(pool, value);
+    co_return doubled + 1;
+}
 
 int main() {
 
@@ -73,6 +88,29 @@ int main() {
             }
     );
 
+    /**
+     * Example 5: Submit() with a typed future.
+     */
+    TaskFuture<int> future = pool->Submit(Examples::fooResultAndParam, 21);
+    printf("\n Future result: %i\n", future.get());
+
+    /**
+     * Example 6: task dependencies, load ---> (parse + index): parse and index wait for load.
+     */
+    TaskGraph graph;
+    TaskGraph::NodeId load = graph.AddNode([](){ printf("\n Graph: load \n"); });
+    TaskGraph::NodeId parse = graph.AddNode([](){ printf("\n Graph: parse \n"); });
+    TaskGraph::NodeId index = graph.AddNode([](){ printf("\n Graph: index \n"); });
+    graph.AddDependency(parse, load);
+    graph.AddDependency(index, load);
+    graph.Run(*pool);
+    printf("\n Graph critical path: %zu nodes\n", graph.CriticalPathLength());
+
+    /**
+     * Example 7: coroutines awaiting each other on the pool.
+     */
+    printf("\n Coroutine result: %i\n", AddOneToDouble(*pool, 20).Get());
+
     printf("\n Thread id for task1: %i\n", task1->GetThreadId());
     printf("\n Thread id for task2: %i\n", task2->GetThreadId());
     printf("\n Thread id for task3: %i\n", task3->GetThreadId());
@@ -0,0 +1,129 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_ARENA_H
+#define THREADPOOLLIB_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Bump allocator for scratch memory, released all at once by rewinding to a mark.
+ *
+ * Allocating is a pointer bump within the current chunk; chunks are kept when rewinding, so
+ * once an arena has grown to what its users need, it no longer touches the global heap.
+ * Nothing is ever destroyed: meant for trivially destructible buffers.
+ *
+ * Every pool worker has one (see ThreadPool::CurrentArena()), to be used through a Scope,
+ * which rewinds to where the arena was when it goes out of scope. Scopes nest, so tasks run
+ * by a worker while another one waits can use the arena as well. An arena is not thread
+ * safe, and its memory must not be kept past the end of its Scope.
+ */
+class Arena {
+
+public:
+    static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+    // Position in the arena, to rewind to.
+    struct Marker {
+        std::size_t chunk;
+        std::size_t offset;
+    };
+
+    class Scope {
+    public:
+        explicit Scope(Arena& arena) noexcept : arena_(arena), mark_(arena.Mark()) {}
+        ~Scope(){ arena_.Rewind(mark_); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void* Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)){
+            return arena_.Allocate(size, alignment);
+        }
+
+        template<typename T>
+        T* AllocateArray(std::size_t count){ return arena_.AllocateArray<T>(count); }
+
+    private:
+        Arena& arena_;
+        Marker mark_;
+    };
+
+    // Chunks are allocated on first use, CHUNK_SIZE bytes each unless an allocation needs more.
+    explicit Arena(std::size_t chunkSize = CHUNK_SIZE) noexcept : chunkSize_(chunkSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // `alignment` has to be a power of two.
+    void* Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)){
+        if(current_ < chunks_.size()){
+            auto base = reinterpret_cast<uintptr_t>(chunks_[current_].data.get());
+            uintptr_t start = (base + offset_ + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+            if(start + size <= base + chunks_[current_].size){
+                offset_ = start + size - base;
+                return reinterpret_cast<void*>(start);
+            }
+        }
+        return Refill(size, alignment);
+    }
+
+    // Room for `count` default-initialized objects (so left uninitialized for scalars).
+    template<typename T>
+    T* AllocateArray(std::size_t count){
+        static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+        T* items = static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+        std::uninitialized_default_construct_n(items, count);
+        return items;
+    }
+
+    Marker Mark() const noexcept { return Marker{current_, offset_}; }
+
+    /**
+     * @brief Frees everything allocated since the mark was taken. Chunks bigger than the
+     * usual size, made for a single big allocation, are given back to the heap.
+     */
+    void Rewind(const Marker& mark) noexcept;
+
+    void Reset() noexcept { Rewind(Marker{0, 0}); }
+
+    // Bytes held, in use or not.
+    std::size_t Capacity() const noexcept;
+
+private:
+    struct Chunk {
+        std::unique_ptr<unsigned char[]> data;
+        std::size_t size;
+    };
+
+    // Moves on to the next chunk, inserting a new one if it is missing or too small.
+    void* Refill(std::size_t size, std::size_t alignment);
+
+    std::size_t chunkSize_;
+    std::vector<Chunk> chunks_;
+    std::size_t current_ = 0;
+    std::size_t offset_ = 0;
+};
+
+#endif //THREADPOOLLIB_ARENA_H
@@ -0,0 +1,268 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_COROUTINE_H
+#define THREADPOOLLIB_COROUTINE_H
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Macros.h"
+#include "ThreadPool.h"
+#include "SlabAllocator.h"
+
+namespace pool {
+
+    template<typename T>
+    class Task;
+
+    /**
+     * @brief Part of every pool::Task promise that does not depend on the result type.
+     *
+     * Coroutine frames are carved from a pool's slabs: the pool passed as an argument to
+     * the coroutine if there is one, otherwise the pool of the calling worker, otherwise
+     * a process-wide slab allocator. Thousands of suspended coroutines thus cost no
+     * global heap traffic once the slabs are warm.
+     */
+    class PromiseBase {
+
+    public:
+        /**
+         * Always inlined into the coroutine: the frame then visibly comes from AllocateFrame(),
+         * which GCC does not try to pair with the operator delete below. A variadic operator
+         * new is never taken as matching a usual operator delete (-Wmismatched-new-delete).
+         */
+        template<typename... Args>
+        ALWAYS_INLINE static void* operator new(std::size_t size, Args&... args){
+            SlabAllocator* slab = nullptr;
+            ((slab = slab ? slab : SlabOf(args)), ...);
+            return AllocateFrame(size, slab);
+        }
+
+        static void operator delete(void* ptr) noexcept { SlabAllocator::Deallocate(ptr); }
+        static void operator delete(void* ptr, std::size_t) noexcept { SlabAllocator::Deallocate(ptr); }
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+
+        /**
+         * Resumes whoever awaits the coroutine right on the thread that finished it, through
+         * symmetric transfer (no queue round-trip, no stack growth).
+         */
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                PromiseBase& promise = handle.promise();
+                if(promise.continuation_)
+                    return promise.continuation_;
+
+                // Keeps the counter alive: the waiter may destroy the frame as soon as it hits zero.
+                std::shared_ptr<std::atomic<int64_t>> running = std::move(promise.running_);
+                if(running && running->fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    running->notify_all();
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        void unhandled_exception() noexcept { exception_ = std::current_exception(); }
+
+    protected:
+        template<typename T> friend class Task;
+
+        /**
+         * Runs the coroutine and blocks until it is over. From a pool worker, pending tasks of
+         * the pool are run meanwhile.
+         */
+        void RunAndWait(std::coroutine_handle<> handle){
+            std::shared_ptr<std::atomic<int64_t>> running = std::make_shared<std::atomic<int64_t>>(1);
+            running_ = running;
+            handle.resume();
+            ThreadPool::HelpUntilZero(*running);
+        }
+
+        void RethrowIfFailed() const {
+            if(exception_)
+                std::rethrow_exception(exception_);
+        }
+
+        std::coroutine_handle<> continuation_;
+        std::shared_ptr<std::atomic<int64_t>> running_;
+        std::exception_ptr exception_;
+
+    private:
+        static void* AllocateFrame(std::size_t size, SlabAllocator* slab){
+            if(!slab)
+                slab = ThreadPool::currentPool_ ? ThreadPool::currentPool_->slab_ : DefaultSlab();
+            return slab->Allocate(size);
+        }
+
+        static SlabAllocator* SlabOf(ThreadPool& pool) noexcept { return pool.slab_; }
+
+        template<typename Argument>
+        static SlabAllocator* SlabOf(Argument&) noexcept { return nullptr; }
+
+        // Never released: frames may be freed up until the very end of the process.
+        static SlabAllocator* DefaultSlab(){
+            static SlabAllocator* slab = new SlabAllocator();
+            return slab;
+        }
+    };
+
+    template<typename T>
+    class Promise : public PromiseBase {
+
+    public:
+        Task<T> get_return_object() noexcept;
+
+        template<typename Value>
+        void return_value(Value&& value){ result_.emplace(std::forward<Value>(value)); }
+
+        T TakeResult(){
+            RethrowIfFailed();
+            return std::move(*result_);
+        }
+
+    private:
+        std::optional<T> result_;
+    };
+
+    template<>
+    class Promise<void> : public PromiseBase {
+
+    public:
+        Task<void> get_return_object() noexcept;
+
+        void return_void() const noexcept {}
+
+        void TakeResult() const { RethrowIfFailed(); }
+    };
+
+    /**
+     * @brief Lazily started coroutine returning a T.
+     *
+     * Nothing runs until the task is co_awaited (or Get() is called), and then it runs on the
+     * awaiting thread until it co_awaits something else, e.g. pool.Schedule() to hop onto a
+     * worker. When it finishes, the awaiting coroutine is resumed straight away on the same
+     * thread. Exceptions propagate to the awaiter.
+     *
+     *     pool::Task<std::string> Load(ThreadPool& pool, std::string path){
+     *         co_await pool.Schedule();
+     *         co_return ReadFile(path);
+     *     }
+     *
+     *     pool::Task<std::size_t> Count(ThreadPool& pool){
+     *         std::string text = co_await Load(pool, "input.txt");
+     *         co_return text.size();
+     *     }
+     *
+     *     std::size_t size = Count(pool).Get();
+     *
+     * A task owns its frame: it must outlive the execution of its coroutine.
+     */
+    template<typename T>
+    class Task {
+
+    public:
+        typedef Promise<T> promise_type;
+        typedef std::coroutine_handle<promise_type> Handle;
+
+        Task() noexcept = default;
+        explicit Task(Handle handle) noexcept : handle_(handle) {}
+
+        Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+        Task& operator=(Task&& other) noexcept {
+            if(this != &other){
+                Destroy();
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task(){ Destroy(); }
+
+        bool IsReady() const noexcept { return handle_ && handle_.done(); }
+
+        struct Awaiter {
+            Handle handle;
+
+            bool await_ready() const noexcept { return !handle || handle.done(); }
+
+            // Starts the awaited coroutine right away on this thread.
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation_ = awaiting;
+                return handle;
+            }
+
+            T await_resume(){
+                if(!handle)
+                    throw std::logic_error("pool::Task: awaiting a task without a coroutine");
+                return handle.promise().TakeResult();
+            }
+        };
+
+        Awaiter operator co_await() const noexcept { return Awaiter{handle_}; }
+
+        /**
+         * @brief Starts the coroutine and blocks until its result is available, for
+         * non-coroutine code. Rethrows the exception the coroutine ended with, if any.
+         */
+        T Get(){
+            if(!handle_)
+                throw std::logic_error("pool::Task: no coroutine to run");
+            if(!handle_.done())
+                handle_.promise().RunAndWait(handle_);
+            return handle_.promise().TakeResult();
+        }
+
+    private:
+        void Destroy() noexcept {
+            if(handle_)
+                handle_.destroy();
+        }
+
+        Handle handle_;
+    };
+
+    template<typename T>
+    Task<T> Promise<T>::get_return_object() noexcept {
+        return Task<T>(Task<T>::Handle::from_promise(*this));
+    }
+
+    inline Task<void> Promise<void>::get_return_object() noexcept {
+        return Task<void>(Task<void>::Handle::from_promise(*this));
+    }
+}
+
+#endif //THREADPOOLLIB_COROUTINE_H
@@ -27,4 +27,29 @@
         __LINE__, __func__, ##__VA_ARGS__); \
     } while (0)
 
+/**
+ * Hint for the CPU that the thread is busy-waiting: lowers power usage and frees
+ * resources for the sibling hyper-thread while spinning.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define CPU_RELAX() asm volatile("yield" ::: "memory")
+#else
+#define CPU_RELAX() do {} while (0)
+#endif
+
+/**
+ * Forces inlining where what the function calls has to show at the call site (e.g. for the
+ * compiler's allocation/deallocation pairing checks).
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define ALWAYS_INLINE __forceinline
+#else
+#define ALWAYS_INLINE inline
+#endif
+
 #endif //THREADPOOLLIB_MACROS_H
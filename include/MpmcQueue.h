@@ -0,0 +1,122 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_MPMCQUEUE_H
+#define THREADPOOLLIB_MPMCQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <cstddef>
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer FIFO queue.
+ *
+ * Every cell carries a sequence number telling which lap of the ring it is ready for:
+ * a producer claims position `pos` with a CAS once the sequence of its cell equals `pos`,
+ * and publishes the item by bumping the sequence to `pos + 1`; a consumer claims it when
+ * the sequence reads `pos + 1` and frees the cell for the next lap with `pos + capacity`.
+ * No operation ever blocks: a full or empty queue just makes it fail.
+ *
+ * Implementation follows Dmitry Vyukov's bounded MPMC queue.
+ *
+ * T must be trivially copyable and default constructible.
+ */
+template<typename T>
+class MpmcQueue {
+
+private:
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T item;
+    };
+
+public:
+    // Capacity is rounded up to a power of two, two at the very least.
+    explicit MpmcQueue(std::size_t capacity)
+        : capacity_(std::bit_ceil(std::max<std::size_t>(capacity, 2))), mask_(capacity_ - 1),
+          cells_(std::make_unique<Cell[]>(capacity_)) {
+        for(std::size_t i = 0; i < capacity_; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    std::size_t Capacity() const noexcept { return capacity_; }
+
+    // Fails only if the queue is full.
+    bool TryPush(T item) noexcept {
+        std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for(;;){
+            Cell& cell = cells_[pos & mask_];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+            if(diff == 0){
+                if(enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(diff < 0)
+                return false;
+            else
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+        Cell& cell = cells_[pos & mask_];
+        cell.item = item;
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Fails if the queue is empty, or if the oldest item is still being published.
+    bool TryPop(T& item) noexcept {
+        std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for(;;){
+            Cell& cell = cells_[pos & mask_];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+            if(diff == 0){
+                if(dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(diff < 0)
+                return false;
+            else
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+        }
+        Cell& cell = cells_[pos & mask_];
+        item = cell.item;
+        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    // Producers and consumers each hammer their own position, kept on separate cache lines.
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> enqueuePos_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> dequeuePos_{0};
+};
+
+#endif //THREADPOOLLIB_MPMCQUEUE_H
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_MPSCQUEUE_H
+#define THREADPOOLLIB_MPSCQUEUE_H
+
+#include <atomic>
+
+/**
+ * @brief Unbounded intrusive multi-producer single-consumer FIFO queue.
+ *
+ * Items derive from MpscQueue::Node. A producer links its node with one exchange and one
+ * store, without ever looping or waiting; the consumer needs no atomic read-modify-write at
+ * all. The queue owns none of the nodes.
+ *
+ * In between those two steps of a producer, the consumer may find nothing to pop while
+ * the queue is not Empty(): the item shows up as soon as the producer is done.
+ *
+ * Implementation follows Dmitry Vyukov's intrusive MPSC node-based queue.
+ */
+class MpscQueue {
+
+public:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+    };
+
+    MpscQueue() noexcept : head_(&stub_), tail_(&stub_) {}
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Any thread.
+    void Push(Node* node) noexcept {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* previous = head_.exchange(node);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer only. nullptr if empty, or if the oldest item is still being linked.
+    Node* Pop() noexcept {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if(tail == &stub_){
+            if(!next)
+                return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if(next){
+            tail_ = next;
+            return tail;
+        }
+
+        // `tail` is the last node: the stub goes behind it, so that it can be handed out.
+        if(tail != head_.load())
+            return nullptr;
+        Push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if(next){
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Consumer only: whether nothing has been pushed that was not popped yet (items
+     * still being linked included). Sequentially consistent, as Push()'s exchange.
+     */
+    bool Empty() const noexcept { return head_.load() == &stub_ && tail_ == &stub_; }
+
+private:
+    std::atomic<Node*> head_;   // Last pushed, producers' end.
+    Node* tail_;                // Next to pop, consumer's end.
+    Node stub_;
+};
+
+#endif //THREADPOOLLIB_MPSCQUEUE_H
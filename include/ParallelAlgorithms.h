@@ -0,0 +1,252 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+/*
+ * Definitions of the ThreadPool parallel algorithms, declared in ThreadPool.h.
+ */
+
+#ifndef THREADPOOLLIB_PARALLELALGORITHMS_H
+#define THREADPOOLLIB_PARALLELALGORITHMS_H
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "ThreadPool.h"
+
+template<typename Index, typename ChunkBody>
+void ThreadPool::ParallelChunks(Index begin, Index end, std::size_t grain, const ChunkBody& chunkBody) {
+    if(!(begin < end))
+        return;
+
+    std::size_t total = static_cast<std::size_t>(end - begin);
+    grain = EffectiveGrain(total, grain);
+    std::size_t chunks = (total + grain - 1) / grain;
+
+    /*
+     * Shared with the helpers: the last one to finish notifies after the caller may have
+     * returned. chunkBody stays on the caller's stack, helpers are done with it by then.
+     */
+    struct LoopState {
+        std::atomic<std::size_t> nextChunk{0};
+        AtomicCounter helpers{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr exception;
+
+        void HelperDone() noexcept {
+            if(helpers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                helpers.notify_all();
+        }
+    };
+    auto state = std::allocate_shared<LoopState>(PooledAllocator<LoopState>(slab_));
+
+    auto work = [state = state.get(), &chunkBody, begin, end, grain, chunks](){
+        for(;;){
+            std::size_t chunk = state->nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if(chunk >= chunks)
+                return;
+
+            Index chunkBegin = begin + static_cast<Index>(chunk * grain);
+            Index chunkEnd = chunk + 1 == chunks ? end : chunkBegin + static_cast<Index>(grain);
+            try {
+                chunkBody(chunkBegin, chunkEnd);
+            } catch(...) {
+                if(!state->failed.exchange(true, std::memory_order_acq_rel))
+                    state->exception = std::current_exception();
+                // Stop handing out chunks.
+                state->nextChunk.store(chunks, std::memory_order_relaxed);
+                return;
+            }
+        }
+    };
+
+    std::size_t helpers = std::min<std::size_t>(GetWorkerCount(), chunks - 1);
+    try {
+        for(std::size_t i = 0; i < helpers; i++){
+            std::shared_ptr<Task> task = NewTask();
+            task->Bind([state, work](){
+                work();
+                state->HelperDone();
+            });
+            // A helper dropped by a cancelling shutdown is done as well: the caller does the chunks.
+            task->OnCancel([](void* context) noexcept { static_cast<LoopState*>(context)->HelperDone(); }, state.get());
+
+            // Counted before it may run, and only kept if it was actually added.
+            state->helpers.fetch_add(1, std::memory_order_relaxed);
+            try {
+                AddTask(std::move(task));
+            } catch(...) {
+                state->helpers.fetch_sub(1, std::memory_order_relaxed);
+                throw;
+            }
+        }
+    } catch(...) {
+        // Helpers already added still run chunkBody: waited for before unwinding.
+        state->nextChunk.store(chunks, std::memory_order_relaxed);
+        HelpUntilZero(state->helpers);
+        throw;
+    }
+
+    work();
+    HelpUntilZero(state->helpers);
+
+    if(state->exception)
+        std::rethrow_exception(state->exception);
+}
+
+template<typename Begin, typename End, typename Body>
+void ThreadPool::ParallelFor(Begin begin, End end, const Body& body, std::size_t grain) {
+    typedef std::common_type_t<Begin, End> Index;
+
+    ParallelChunks<Index>(begin, end, grain, [&body](Index chunkBegin, Index chunkEnd){
+        for(Index i = chunkBegin; i < chunkEnd; ++i)
+            body(i);
+    });
+}
+
+template<typename Begin, typename End, typename T, typename Map, typename Reduce>
+T ThreadPool::ParallelReduce(Begin begin, End end, T identity, const Map& map, const Reduce& reduce, std::size_t grain) {
+    typedef std::common_type_t<Begin, End> Index;
+
+    if(!(static_cast<Index>(begin) < static_cast<Index>(end)))
+        return identity;
+
+    std::size_t total = static_cast<std::size_t>(static_cast<Index>(end) - static_cast<Index>(begin));
+    grain = EffectiveGrain(total, grain);
+
+    // One partial per chunk, combined in order afterwards.
+    std::vector<T> partials((total + grain - 1) / grain, identity);
+    ParallelChunks<Index>(begin, end, grain, [&](Index chunkBegin, Index chunkEnd){
+        T accumulator = identity;
+        for(Index i = chunkBegin; i < chunkEnd; ++i)
+            accumulator = reduce(std::move(accumulator), map(i));
+        partials[static_cast<std::size_t>(chunkBegin - static_cast<Index>(begin)) / grain] = std::move(accumulator);
+    });
+
+    T result = std::move(identity);
+    for(T& partial : partials)
+        result = reduce(std::move(result), std::move(partial));
+    return result;
+}
+
+template<typename RandomIt, typename RandomOutputIt, typename UnaryOp>
+RandomOutputIt ThreadPool::ParallelTransform(RandomIt first, RandomIt last, RandomOutputIt output, const UnaryOp& op, std::size_t grain) {
+    static_assert(std::random_access_iterator<RandomIt>, "ParallelTransform() needs random access input iterators");
+    std::size_t total = static_cast<std::size_t>(std::distance(first, last));
+
+    ParallelChunks<std::size_t>(0, total, grain, [&](std::size_t chunkBegin, std::size_t chunkEnd){
+        RandomIt in = first + chunkBegin;
+        RandomOutputIt out = output + chunkBegin;
+        for(std::size_t i = chunkBegin; i < chunkEnd; ++i, ++in, ++out)
+            *out = op(*in);
+    });
+    return output + total;
+}
+
+template<typename RandomIt, typename Compare>
+void ThreadPool::ParallelSort(RandomIt first, RandomIt last, Compare comp) {
+    static_assert(std::random_access_iterator<RandomIt>, "ParallelSort() needs random access iterators");
+    // Below this, splitting costs more than it saves.
+    constexpr std::size_t SERIAL_CUTOFF = 2048;
+
+    std::size_t total = static_cast<std::size_t>(std::distance(first, last));
+    std::size_t blocks = std::min(Participants(), total / SERIAL_CUTOFF);
+    if(blocks < 2){
+        std::sort(first, last, comp);
+        return;
+    }
+
+    std::size_t blockSize = (total + blocks - 1) / blocks;
+    ParallelChunks<std::size_t>(0, blocks, 1, [&](std::size_t blockBegin, std::size_t blockEnd){
+        for(std::size_t block = blockBegin; block < blockEnd; block++){
+            std::size_t low = std::min(total, block * blockSize);
+            std::size_t high = std::min(total, low + blockSize);
+            std::sort(first + low, first + high, comp);
+        }
+    });
+
+    // Merge sorted runs pairwise, doubling their width on every round.
+    for(std::size_t width = blockSize; width < total; width *= 2){
+        std::size_t pairs = (total + 2 * width - 1) / (2 * width);
+        ParallelChunks<std::size_t>(0, pairs, 1, [&](std::size_t pairBegin, std::size_t pairEnd){
+            for(std::size_t pair = pairBegin; pair < pairEnd; pair++){
+                std::size_t low = pair * 2 * width;
+                std::size_t middle = std::min(total, low + width);
+                std::size_t high = std::min(total, low + 2 * width);
+                if(middle < high)
+                    std::inplace_merge(first + low, first + middle, first + high, comp);
+            }
+        });
+    }
+}
+
+template<typename RandomIt, typename RandomOutputIt, typename BinaryOp>
+RandomOutputIt ThreadPool::ParallelScan(RandomIt first, RandomIt last, RandomOutputIt output, BinaryOp op) {
+    static_assert(std::random_access_iterator<RandomIt>, "ParallelScan() needs random access input iterators");
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    constexpr std::size_t SERIAL_CUTOFF = 4096;
+
+    std::size_t total = static_cast<std::size_t>(std::distance(first, last));
+    std::size_t blocks = std::min(Participants() * 4, total / SERIAL_CUTOFF);
+    if(blocks < 2)
+        return std::inclusive_scan(first, last, output, op);
+
+    std::size_t blockSize = (total + blocks - 1) / blocks;
+    blocks = (total + blockSize - 1) / blockSize;
+
+    // 1. Reduce every block.
+    std::vector<std::optional<T>> sums(blocks);
+    ParallelChunks<std::size_t>(0, blocks, 1, [&](std::size_t blockBegin, std::size_t blockEnd){
+        for(std::size_t block = blockBegin; block < blockEnd; block++){
+            std::size_t low = block * blockSize;
+            std::size_t high = std::min(total, low + blockSize);
+            T accumulator = first[low];
+            for(std::size_t i = low + 1; i < high; i++)
+                accumulator = op(std::move(accumulator), first[i]);
+            sums[block] = std::move(accumulator);
+        }
+    });
+
+    // 2. Prefix of the block sums, serially: there are only a few of them.
+    for(std::size_t block = 1; block < blocks; block++)
+        sums[block] = op(*sums[block - 1], *sums[block]);
+
+    // 3. Scan every block, starting off the prefix of the previous ones.
+    ParallelChunks<std::size_t>(0, blocks, 1, [&](std::size_t blockBegin, std::size_t blockEnd){
+        for(std::size_t block = blockBegin; block < blockEnd; block++){
+            std::size_t low = block * blockSize;
+            std::size_t high = std::min(total, low + blockSize);
+            T accumulator = block == 0 ? T(first[low]) : op(*sums[block - 1], first[low]);
+            output[low] = accumulator;
+            for(std::size_t i = low + 1; i < high; i++){
+                accumulator = op(std::move(accumulator), first[i]);
+                output[i] = accumulator;
+            }
+        }
+    });
+
+    return output + total;
+}
+
+#endif //THREADPOOLLIB_PARALLELALGORITHMS_H
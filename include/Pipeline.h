@@ -0,0 +1,310 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_PIPELINE_H
+#define THREADPOOLLIB_PIPELINE_H
+
+#include <any>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "TaskFunction.h"
+
+class ThreadPool;
+
+/**
+ * How a pipeline stage handles its items:
+ * STAGE_PARALLEL: any number of items at once.
+ * STAGE_SERIAL_IN_ORDER: one item at a time, in the order the source produced them.
+ * STAGE_SERIAL_OUT_OF_ORDER: one item at a time, in whatever order they reach the stage.
+ */
+enum StageMode {
+    STAGE_PARALLEL = 0,
+    STAGE_SERIAL_IN_ORDER = 1,
+    STAGE_SERIAL_OUT_OF_ORDER = 2
+};
+
+/**
+ * @brief Multi-stage pipeline over a ThreadPool, with a bounded number of items in flight.
+ *
+ * A serial source produces the items, then every stage turns an item into the input of the
+ * next one. At most `maxTokens` items are in between the source and the end of the last
+ * stage: the source only runs when one has made it through, so memory stays bounded however
+ * slow the downstream stages are.
+ *
+ * A worker carries its item through consecutive stages while the item is hot in its cache,
+ * and goes back to the source with the token once it is through. Only an item reaching a
+ * serial stage that is busy (or, in order, not at its turn) is set aside; the stage hands it
+ * to a new task when it is free. Items are kept inside their token when they fit in
+ * THREADPOOL_TASK_INLINE_SIZE bytes (like task callables), so passing an item on to the next
+ * stage allocates nothing; bigger items are moved to the heap at every stage that produces
+ * one. What an item owns (e.g. the characters of a long std::string) is up to its type.
+ * Those hand-offs are never turned away by a full lock-free queue under FULL_QUEUE_REJECT:
+ * the worker runs other tasks until there is room. Only Run() itself, from outside the pool,
+ * may throw QueueFullError.
+ *
+ *     Pipeline pipeline(pool, 16);
+ *     pipeline.Source([&](Pipeline::FlowControl& flow){
+ *                 std::string line;
+ *                 if(!std::getline(input, line))
+ *                     flow.Stop();
+ *                 return line;
+ *             })
+ *             .Then(STAGE_PARALLEL, [](std::string line){ return Parse(line); })
+ *             .Then(STAGE_SERIAL_IN_ORDER, [&](Record record){ Write(output, record); });
+ *     pipeline.Run();
+ */
+class Pipeline {
+
+public:
+    // Handed to the source: once it calls Stop(), what it returns is dropped and no more items are produced.
+    class FlowControl {
+    public:
+        void Stop() noexcept { stopped_ = true; }
+        bool IsStopped() const noexcept { return stopped_; }
+
+    private:
+        bool stopped_ = false;
+    };
+
+    // The pool must outlive the pipeline. maxTokens of 0 is taken as 1.
+    Pipeline(ThreadPool& pool, std::size_t maxTokens);
+
+    /**
+     * @brief Sets the source, func(FlowControl&) returning the next item. It always runs
+     * serially, and items are numbered in the order it produces them.
+     */
+    template<typename Function>
+    Pipeline& Source(Function&& func){
+        using Output = std::invoke_result_t<std::decay_t<Function>&, FlowControl&>;
+        static_assert(!std::is_void_v<Output>, "Pipeline::Source() has to return the items");
+        state_->source = [func = std::forward<Function>(func)](Value& value, FlowControl& flow) mutable {
+            Output item = func(flow);
+            if(!flow.IsStopped())
+                value.Emplace(std::move(item));
+        };
+        return *this;
+    }
+
+    /**
+     * @brief Appends a stage, func(In) returning the input of the next stage (or nothing,
+     * for the last one).
+     *
+     * `In` is deduced from func unless it is generic (e.g. auto parameters), in which case
+     * it has to be given: Then<Record>(mode, func). An item of another type than the
+     * previous stage returns makes Run() throw std::bad_any_cast.
+     */
+    template<typename In = void, typename Function>
+    Pipeline& Then(StageMode mode, Function&& func){
+        using Input = std::decay_t<typename std::conditional_t<std::is_void_v<In>,
+                FirstArgument<std::decay_t<Function>>, std::type_identity<In>>::type>;
+        using Output = std::invoke_result_t<std::decay_t<Function>&, Input&&>;
+
+        auto stage = std::make_unique<Stage>(mode, maxTokens_);
+        stage->function = [func = std::forward<Function>(func)](Value& value) mutable {
+            Input* input = value.Get<Input>();
+            if(!input)
+                throw std::bad_any_cast();
+            if constexpr(std::is_void_v<Output>){
+                func(std::move(*input));
+                value.Reset();
+            } else if constexpr(std::is_same_v<std::decay_t<Output>, Input>){
+                *input = func(std::move(*input));
+            } else {
+                value.Emplace(func(std::move(*input)));
+            }
+        };
+        state_->stages.push_back(std::move(stage));
+        return *this;
+    }
+
+    /**
+     * @brief Runs the pipeline until the source stops and every item has gone through,
+     * helping with pending tasks meanwhile if called from a worker.
+     *
+     * If a stage (or the source) throws, no more items are produced, those in flight are
+     * dropped at their next stage, and the first exception is rethrown here. The pipeline
+     * can be run again afterwards, one Run() at a time.
+     */
+    void Run();
+
+    std::size_t GetMaxTokens() const noexcept { return maxTokens_; }
+
+private:
+    /**
+     * The item a token carries, of whatever type the last stage returned. Stored in place
+     * when it fits in THREADPOOL_TASK_INLINE_SIZE bytes, on the heap otherwise. Tokens never
+     * move, so neither does the value.
+     */
+    class Value {
+    public:
+        Value() = default;
+        ~Value(){ Reset(); }
+
+        Value(const Value&) = delete;
+        Value& operator=(const Value&) = delete;
+
+        // The value if it is a T, nullptr otherwise.
+        template<typename T>
+        T* Get() noexcept {
+            if(vtable_ != &vtable<T>)
+                return nullptr;
+            return IsInline<T> ? std::launder(reinterpret_cast<T*>(storage_)) : *reinterpret_cast<T**>(storage_);
+        }
+
+        template<typename T>
+        void Emplace(T&& value){
+            typedef std::decay_t<T> V;
+            Reset();
+            if constexpr(IsInline<V>)
+                ::new(static_cast<void*>(storage_)) V(std::forward<T>(value));
+            else
+                *reinterpret_cast<V**>(storage_) = new V(std::forward<T>(value));
+            vtable_ = &vtable<V>;
+        }
+
+        void Reset() noexcept {
+            if(vtable_)
+                std::exchange(vtable_, nullptr)->destroy(storage_);
+        }
+
+    private:
+        static constexpr std::size_t INLINE_SIZE = THREADPOOL_TASK_INLINE_SIZE;
+        static constexpr std::size_t INLINE_ALIGN = alignof(std::max_align_t);
+
+        // One per type: its address identifies the type of the value.
+        struct VTable {
+            void (*destroy)(void* storage) noexcept;
+        };
+
+        template<typename T>
+        static constexpr bool IsInline = sizeof(T) <= INLINE_SIZE && alignof(T) <= INLINE_ALIGN;
+
+        template<typename T>
+        static constexpr VTable vtable = {
+            [](void* storage) noexcept {
+                if constexpr(IsInline<T>)
+                    std::launder(static_cast<T*>(storage))->~T();
+                else
+                    delete *static_cast<T**>(storage);
+            }
+        };
+
+        alignas(INLINE_ALIGN) unsigned char storage_[INLINE_SIZE];
+        const VTable* vtable_ = nullptr;
+    };
+
+    // Token: an item in flight, reused for the next one once through.
+    struct State;
+    struct Item {
+        State* state = nullptr;
+        uint64_t sequence = 0;
+        Value value;
+    };
+
+    /**
+     * Serial stages keep the items that have to wait in `waiting`: in order, in the slot of
+     * their sequence modulo maxTokens (all items from `next` on are in flight, so they never
+     * collide); otherwise as a FIFO ring. The source (stage 0) parks the free tokens there.
+     */
+    struct Stage {
+        Stage(StageMode mode, std::size_t maxTokens) : mode(mode), waiting(maxTokens, nullptr) {}
+
+        StageMode mode;
+        std::function<void(Value&)> function;
+
+        // Guarded by mutex.
+        std::mutex mutex;
+        bool busy = false;
+        uint64_t next = 0;      // In order: sequence of the next item to run.
+        std::vector<Item*> waiting;
+        std::size_t head = 0;
+        std::size_t count = 0;
+    };
+
+    struct State {
+        ThreadPool* pool;
+        std::function<void(Value&, FlowControl&)> source;
+        std::vector<std::unique_ptr<Stage>> stages;
+        std::unique_ptr<Item[]> items;
+
+        // Per run. `stopped` is guarded by the source's mutex, `produced` only used by whoever runs the source.
+        bool stopped = false;
+        uint64_t produced = 0;
+        std::atomic<int64_t> liveTokens{0};     // Whoever brings it down to zero notifies.
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> failed{false};
+        std::exception_ptr exception;
+    };
+
+    template<typename F>
+    struct FirstArgument : FirstArgument<decltype(&F::operator())> {};
+    template<typename R, typename A>
+    struct FirstArgument<R (*)(A)> { using type = A; };
+    template<typename R, typename C, typename A>
+    struct FirstArgument<R (C::*)(A)> { using type = A; };
+    template<typename R, typename C, typename A>
+    struct FirstArgument<R (C::*)(A) const> { using type = A; };
+    template<typename R, typename C, typename A>
+    struct FirstArgument<R (C::*)(A) noexcept> { using type = A; };
+    template<typename R, typename C, typename A>
+    struct FirstArgument<R (C::*)(A) const noexcept> { using type = A; };
+
+    /**
+     * Body of the pipeline's tasks: takes the item through the stages from `stage` on, around
+     * to the source and so on, until it has to wait at a serial stage or its token retires.
+     * `claimed`: the serial stage `stage` was already reserved for the item.
+     */
+    static void Carry(const std::shared_ptr<State>& state, Item* item, std::size_t stage, bool claimed);
+
+    // Runs a stage (or the source) on the item. False if the item is to be dropped.
+    static bool RunStage(State& state, Stage& stage, std::size_t index, Item* item);
+
+    // A serial stage is done with an item: the next one waiting, if its turn has come, gets it in a new task.
+    static void Release(const std::shared_ptr<State>& state, Stage& stage, std::size_t index);
+
+    // Submits a task carrying the item from `stage` on, that stage being reserved for it.
+    static void Schedule(const std::shared_ptr<State>& state, Item* item, std::size_t stage);
+
+    // Records the first exception, then no more items: every waiting one is retired, and those in flight at their next stage.
+    static void Fail(State& state, std::exception_ptr exception) noexcept;
+
+    // Cancel hook of the tasks (see Task::OnCancel()): a cancelling shutdown fails the pipeline.
+    static void Cancelled(void* item) noexcept;
+
+    static void Retire(State& state, Item* item) noexcept;
+
+    static void Push(Stage& stage, Item* item) noexcept;
+    static Item* Pop(Stage& stage) noexcept;
+
+    std::size_t maxTokens_;
+    std::shared_ptr<State> state_;
+};
+
+#endif //THREADPOOLLIB_PIPELINE_H
@@ -0,0 +1,151 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_POOLMETRICS_H
+#define THREADPOOLLIB_POOLMETRICS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TaskOptions.h"
+
+/**
+ * Metrics are compiled in unless THREADPOOL_METRICS is defined to 0 (CMake option
+ * THREADPOOL_METRICS=OFF). When compiled out, workers keep no counters at all and
+ * ThreadPool::Snapshot() only reports the queue gauges. Code built with another value
+ * than the library fails to link (see ThreadPool::BuildFlags).
+ */
+#ifndef THREADPOOL_METRICS
+#define THREADPOOL_METRICS 1
+#endif
+
+// Monotonic timestamp in nanoseconds, as used for task timings.
+inline uint64_t SteadyNanoseconds() noexcept {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+enum MetricsFormat {
+    METRICS_INFLUX = 0,         // InfluxDB line protocol.
+    METRICS_PROMETHEUS = 1      // Prometheus text exposition format.
+};
+
+/**
+ * Task run times are bucketed by powers of two nanoseconds: bucket i holds the
+ * durations in [2^(i-1), 2^i) ns, the last one everything above.
+ */
+static constexpr std::size_t METRICS_HISTOGRAM_BUCKETS = 40;
+
+typedef std::array<uint64_t, METRICS_HISTOGRAM_BUCKETS> HistogramBuckets;
+
+/**
+ * @brief Counters of a single worker, as read by ThreadPool::Snapshot(). Times in nanoseconds.
+ */
+struct WorkerMetricsSnapshot {
+    uint64_t tasksExecuted = 0;
+    uint64_t busyTime = 0;          // Running tasks.
+    uint64_t idleTime = 0;          // Spinning or parked, looking for work.
+    uint64_t queueWaitTime = 0;     // Summed up from enqueue to start, over every executed task.
+    uint64_t steals = 0;            // Tasks taken from another worker's deque.
+    uint64_t lockContentions = 0;   // Times the shared queue lock was found taken.
+    HistogramBuckets runTimeHistogram{};
+    std::array<uint64_t, PRIORITY_CLASSES> priorityTasks{};     // Tasks executed, by priority class.
+    std::array<uint64_t, PRIORITY_CLASSES> priorityWaitTime{};  // Their summed up queue wait.
+
+    WorkerMetricsSnapshot& operator+=(const WorkerMetricsSnapshot& other) noexcept;
+
+    // Upper bound, in nanoseconds, of the run time below which a `p` (0..1) fraction of the tasks finished.
+    uint64_t RunTimePercentile(double p) const noexcept;
+};
+
+/**
+ * @brief Point in time view of a pool's metrics.
+ */
+struct MetricsSnapshot {
+    std::vector<WorkerMetricsSnapshot> workers;
+    int64_t pendingTasks = 0;
+    int64_t sleepingWorkers = 0;
+    std::array<int64_t, PRIORITY_CLASSES> queueDepth{};    // Shared queue of every priority class.
+    uint64_t rejectedTasks = 0;     // Submissions turned away: pool at capacity or full queue.
+    uint64_t cancelledTasks = 0;    // Dropped without running: stop requested, or discarded by a shutdown.
+    uint64_t expiredTasks = 0;      // Dropped without running: deadline passed while queued.
+    int64_t admittedBytes = 0;      // Captured state of the queued tasks, if admission control is on.
+    int64_t blockedWorkers = 0;     // Workers inside a blocking region (see ScopedBlocking).
+    int64_t spareWorkers = 0;       // Workers running in their place.
+    uint64_t compensations = 0;     // Spare workers started so far.
+    uint64_t timestamp = 0;         // Nanoseconds since the epoch (system clock).
+
+    // All the workers added up.
+    WorkerMetricsSnapshot Total() const noexcept;
+
+    /**
+     * @brief Renders the snapshot in the given format, one series per worker.
+     *
+     * `name` prefixes every series (measurement name for InfluxDB).
+     */
+    std::string Format(MetricsFormat format, const std::string& name = "threadpool") const;
+};
+
+#if THREADPOOL_METRICS
+/**
+ * @brief Per-worker counters, written only by the worker that owns them.
+ *
+ * Being single-writer, updates are plain relaxed load + store (no locked instructions);
+ * relaxed atomics still let Snapshot() read them from any thread while workers run.
+ * Over-aligned so that counters of different workers never share a cache line.
+ */
+struct alignas(64) WorkerMetrics {
+    typedef std::atomic<uint64_t> Counter;
+
+    static void Add(Counter& counter, uint64_t value) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void RecordTask(TaskPriority priority, uint64_t queueWait, uint64_t runTime) noexcept {
+        Add(tasksExecuted, 1);
+        Add(queueWaitTime, queueWait);
+        Add(priorityTasks[priority], 1);
+        Add(priorityWaitTime[priority], queueWait);
+        Add(busyTime, runTime);
+        Add(runTimeHistogram[std::min<std::size_t>(std::bit_width(runTime), METRICS_HISTOGRAM_BUCKETS - 1)], 1);
+    }
+
+    WorkerMetricsSnapshot Load() const noexcept;
+
+    Counter tasksExecuted{0};
+    Counter busyTime{0};
+    Counter idleTime{0};
+    Counter queueWaitTime{0};
+    Counter steals{0};
+    Counter lockContentions{0};
+    std::array<Counter, METRICS_HISTOGRAM_BUCKETS> runTimeHistogram{};
+    std::array<Counter, PRIORITY_CLASSES> priorityTasks{};
+    std::array<Counter, PRIORITY_CLASSES> priorityWaitTime{};
+};
+#endif
+
+#endif //THREADPOOLLIB_POOLMETRICS_H
@@ -0,0 +1,77 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_RINGBUFFER_H
+#define THREADPOOLLIB_RINGBUFFER_H
+
+#include <memory>
+#include <cstddef>
+
+/**
+ * @brief Growable FIFO circular buffer. Not thread-safe.
+ *
+ * Drop-in replacement for std::queue when the element type is trivially copyable:
+ * std::deque allocates and frees a node every few dozen elements in a FIFO pattern,
+ * this one only allocates when it has to grow and keeps its storage afterwards.
+ */
+template<typename T>
+class RingBuffer {
+
+public:
+    // Capacity must be a power of two.
+    explicit RingBuffer(std::size_t capacity = 256)
+        : capacity_(capacity), buffer_(std::make_unique<T[]>(capacity)) {}
+
+    bool empty() const noexcept { return size_ == 0; }
+    std::size_t size() const noexcept { return size_; }
+
+    T& front() noexcept { return buffer_[head_]; }
+
+    void push(T item){
+        if(size_ == capacity_)
+            Grow();
+        buffer_[(head_ + size_) & (capacity_ - 1)] = item;
+        size_++;
+    }
+
+    void emplace(T item){ push(item); }
+
+    void pop() noexcept {
+        head_ = (head_ + 1) & (capacity_ - 1);
+        size_--;
+    }
+
+private:
+    void Grow(){
+        std::unique_ptr<T[]> buffer = std::make_unique<T[]>(capacity_ * 2);
+        for(std::size_t i = 0; i < size_; i++)
+            buffer[i] = buffer_[(head_ + i) & (capacity_ - 1)];
+        buffer_ = std::move(buffer);
+        capacity_ *= 2;
+        head_ = 0;
+    }
+
+    std::size_t capacity_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    std::unique_ptr<T[]> buffer_;
+};
+
+#endif //THREADPOOLLIB_RINGBUFFER_H
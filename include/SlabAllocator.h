@@ -0,0 +1,157 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_SLABALLOCATOR_H
+#define THREADPOOLLIB_SLABALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AllocationStats {
+    uint64_t slabAllocations;   // Blocks handed out from the slabs.
+    uint64_t heapAllocations;   // Calls that reached the global heap (new chunks, oversized blocks...).
+};
+
+/**
+ * @brief Size-class slab allocator with per-thread heaps.
+ *
+ * Every thread allocating from a SlabAllocator gets its own Heap, with one freelist per
+ * size class, so allocations never take a lock. A block freed by its owner thread goes back
+ * to the local freelist; a block freed by any other thread is pushed onto the owner heap's
+ * lock-free "remote" list, which the owner adopts once its local list runs dry. In a
+ * steady producer/consumer pattern blocks keep circulating and the global heap is not hit.
+ *
+ * The allocator is not destroyed directly but Release()d by its owner: blocks may still be
+ * referenced (e.g. a std::shared_ptr<Task> held by the user after the pool is gone), in that
+ * case the memory is reclaimed once the last block has been returned, as noticed by the next
+ * Release() or when a thread that allocated from any slab exits.
+ */
+class SlabAllocator {
+
+public:
+    static constexpr std::size_t SIZE_CLASSES = 5;
+    static constexpr std::size_t MIN_BLOCK_SIZE = 64;
+    static constexpr std::size_t MAX_BLOCK_SIZE = MIN_BLOCK_SIZE << (SIZE_CLASSES - 1);
+    static constexpr std::size_t CHUNK_SIZE = 16 * 1024;
+
+    SlabAllocator();
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    void* Allocate(std::size_t size);
+    static void Deallocate(void* ptr) noexcept;
+
+    // Gives up ownership; the memory goes away as soon as no block is in use anymore.
+    void Release();
+
+    AllocationStats Stats() const;
+
+private:
+    struct Heap;
+
+    struct BlockHeader {
+        Heap* heap;             // nullptr if the block came straight from the global heap.
+        uint32_t sizeClass;
+        uint32_t reserved;
+    };
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct alignas(64) Heap {
+        SlabAllocator* allocator;
+        uint64_t allocatorId;
+        std::thread::id owner;
+
+        // Owner thread only.
+        FreeBlock* freeLists[SIZE_CLASSES]{};
+        std::vector<std::unique_ptr<unsigned char[]>> chunks;
+        std::atomic<int64_t> allocated{0};
+        std::atomic<uint64_t> served{0};
+
+        // Any thread.
+        alignas(64) std::atomic<FreeBlock*> remoteFree[SIZE_CLASSES]{};
+        std::atomic<int64_t> remoteFreed{0};
+    };
+
+    struct HeapCache {
+        uint64_t allocatorId;
+        Heap* heap;
+    };
+
+    // Reaps the orphans left once its thread exits; every thread that gets a heap holds one.
+    struct Reaper {
+        ~Reaper();
+    };
+
+    ~SlabAllocator() = default;
+
+    Heap* LocalHeap();
+    void* Refill(Heap* heap, uint32_t sizeClass);
+    int64_t LiveBlocks() const;
+
+    static void ReapOrphans();
+
+    uint64_t id_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Heap>> heaps_;
+    std::atomic<uint64_t> heapAllocations_{0};
+
+    static thread_local HeapCache cache_;
+    static thread_local Reaper reaper_;
+};
+
+/**
+ * @brief Standard allocator adapter over a SlabAllocator.
+ *
+ * Meant for std::allocate_shared, so that the Task and its control block live in a
+ * single slab block.
+ */
+template<typename T>
+class PooledAllocator {
+
+public:
+    typedef T value_type;
+
+    explicit PooledAllocator(SlabAllocator* slab) noexcept : slab_(slab) {}
+
+    template<typename U>
+    PooledAllocator(const PooledAllocator<U>& other) noexcept : slab_(other.slab_) {}
+
+    T* allocate(std::size_t n){ return static_cast<T*>(slab_->Allocate(n * sizeof(T))); }
+    void deallocate(T* ptr, std::size_t) noexcept { SlabAllocator::Deallocate(ptr); }
+
+    template<typename U>
+    bool operator==(const PooledAllocator<U>& other) const noexcept { return slab_ == other.slab_; }
+
+private:
+    template<typename U> friend class PooledAllocator;
+
+    SlabAllocator* slab_;
+};
+
+#endif //THREADPOOLLIB_SLABALLOCATOR_H
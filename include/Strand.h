@@ -0,0 +1,141 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_STRAND_H
+#define THREADPOOLLIB_STRAND_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "MpscQueue.h"
+#include "TaskFunction.h"
+
+class ThreadPool;
+
+/**
+ * @brief Serial executor on top of a ThreadPool: callables posted to the same strand run one
+ * at a time, in the order they were posted, while different strands run in parallel.
+ *
+ * A strand is a lock-free MPSC queue plus a "scheduled" flag. Whoever posts to an idle strand
+ * raises the flag and submits a single task that drains the queue; posting to a busy strand
+ * is just a push. No worker ever blocks on a strand, and the next callable of a strand runs
+ * on whichever worker is free. A drain gives its worker back every BURST callables, so that
+ * a busy strand does not starve the rest of the pool.
+ *
+ * Copies of a Strand refer to the same strand. The pool must outlive it.
+ *
+ *     Strand session(pool);
+ *     session.Post([&]{ state.Apply(first); });
+ *     session.Post([&]{ state.Apply(second); });     // Runs after the first one is over.
+ */
+class Strand {
+
+public:
+    static constexpr std::size_t BURST = 64;
+
+    explicit Strand(ThreadPool& pool);
+
+    /**
+     * @brief Queues a callable. Everything posted before it to this strand, by any thread,
+     * will have finished when it starts.
+     *
+     * Exceptions it throws (of any type) are logged and dropped. Throws PoolShutdownError
+     * (from outside the pool) once a shutdown has started. If the shutdown starts while
+     * posting, the callable may stay queued although Post() throws: it runs with the
+     * strand's next drain, if there ever is one.
+     */
+    template<typename Function>
+    void Post(Function&& func){
+        Push(TaskFunction(std::forward<Function>(func)));
+    }
+
+    // Whether nothing is queued nor running on the strand (as of now, posts may be racing).
+    bool IsIdle() const noexcept { return !state_->scheduled.load(std::memory_order_acquire); }
+
+private:
+    struct Item : MpscQueue::Node {
+        TaskFunction function;
+    };
+
+    struct State {
+        explicit State(ThreadPool* pool) noexcept : pool(pool) {}
+        ~State();
+
+        ThreadPool* pool;
+        MpscQueue items;
+        std::atomic<bool> scheduled{false};     // A drain task is queued or running.
+
+        /**
+         * Items pushed and not run yet, counted by producers after pushing and by the drain
+         * after popping (so it may dip below zero meanwhile). Unlike the queue's consumer
+         * end, it can be read by a drain that has given up the strand.
+         */
+        std::atomic<int64_t> pending{0};
+    };
+
+    void Push(TaskFunction function);
+
+    /**
+     * Submits a task draining the strand. A drain resubmitting itself hands off (see
+     * ThreadPool::HandOff()): a full rejecting queue must not strand the items left.
+     */
+    static void Schedule(const std::shared_ptr<State>& state, bool handOff = false);
+
+    // Body of that task: runs up to BURST items, then either resubmits itself or lowers the flag.
+    static void Drain(const std::shared_ptr<State>& state);
+
+    std::shared_ptr<State> state_;
+};
+
+/**
+ * @brief A fixed set of strands, picked by key: everything posted with the same key runs in
+ * order, keys landing on different strands run in parallel.
+ *
+ * Cheaper than a strand per key when keys are many and short-lived (sessions, connections).
+ */
+class StrandGroup {
+
+public:
+    StrandGroup(ThreadPool& pool, std::size_t strands);
+
+    template<typename Key>
+    Strand& For(const Key& key){
+        // Hashes of integers are often the integers themselves: mixed, so that strided keys spread out.
+        uint64_t hash = static_cast<uint64_t>(std::hash<Key>{}(key)) * 0x9E3779B97F4A7C15ull;
+        return strands_[(hash >> 32) % strands_.size()];
+    }
+
+    template<typename Key, typename Function>
+    void Post(const Key& key, Function&& func){
+        For(key).Post(std::forward<Function>(func));
+    }
+
+    std::size_t Size() const noexcept { return strands_.size(); }
+
+private:
+    std::vector<Strand> strands_;
+};
+
+#endif //THREADPOOLLIB_STRAND_H
@@ -18,9 +18,17 @@
  * @author - Geru-Scotland (https://github.com/geru-scotland)
  */
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <tuple>
+#include <type_traits>
 #include "Macros.h"
+#include "PoolMetrics.h"
+#include "TaskOptions.h"
+#include "TaskFunction.h"
 
 #ifndef THREADPOOLLIB_TASK_H
 #define THREADPOOLLIB_TASK_H
@@ -28,9 +36,33 @@
 enum TaskStatus {
     STATUS_PENDING = 0,
     STATUS_RUNNING = 1,
-    STATUS_DONE = 2
+    STATUS_DONE = 2,
+    STATUS_CANCELLED = 3     // Finished without running: stopped, expired or discarded by a shutdown.
 };
 
+template<typename T>
+struct IsTuple : std::false_type {};
+
+template<typename... Types>
+struct IsTuple<std::tuple<Types...>> : std::true_type {};
+
+// Argument tuples of CreateTask(func, [callback,] argsTuple), of any value category.
+template<typename T>
+concept ArgumentsTuple = IsTuple<std::remove_cvref_t<T>>::value;
+
+/**
+ * @brief Turns an argument tuple into one holding values (references stripped), moving or
+ * copying each element as the tuple's value category allows.
+ *
+ * Tuples of references (std::forward_as_tuple) would otherwise dangle; std::ref() is
+ * still the way to really pass a reference.
+ */
+template<typename Tuple>
+auto DecayArguments(Tuple&& argsTuple){
+    return std::apply([](auto&&... args){ return std::make_tuple(std::forward<decltype(args)>(args)...); },
+                      std::forward<Tuple>(argsTuple));
+}
+
 class Task {
 
 public:
@@ -43,26 +75,24 @@ public:
      * provided in `argsTuple`, along with an associated callback `callback` to be executed
      * after `func` finishes its execution.
      *
-     * Using std::invoke_result_t helps deduce the correct return type for the function `func`,
-     * and std::is_void_v helps handle the different cases for the callback execution based on
-     * the return type of the function.
+     * The callable, the callback and every argument are perfectly forwarded into the stored
+     * task: rvalues are moved and lvalues copied, so nothing refers back to the caller's
+     * objects once this returns, and move-only types (std::unique_ptr, large buffers) are
+     * accepted. The arguments are handed to `func` as rvalues, a task only runs once.
      *
-     * This approach provides flexibility in handling different function signatures, optimizing
-     * performance by avoiding unnecessary copy or move operations, and offers a clean way to
-     * execute a callback function post task execution.
+     * Checking the return type with std::is_void_v decides whether the callback receives it.
      */
-    template<typename Function, typename Callback, typename... Types>
-    void operator()(Function&& func, Callback&& callback, const std::tuple<Types...>& argsTuple){
-
-        typedef std::invoke_result_t<Function, Types...> ReturnType;
-
-        task_ = [&func, &callback, argsTuple] ()
+    template<typename Function, typename Callback, typename Tuple>
+        requires ArgumentsTuple<Tuple>
+    void operator()(Function&& func, Callback&& callback, Tuple&& argsTuple){
+        task_ = [func = std::forward<Function>(func), callback = std::forward<Callback>(callback),
+                 args = DecayArguments(std::forward<Tuple>(argsTuple))] () mutable
         {
-            if constexpr(std::is_void_v<ReturnType>){
-                std::apply(func, argsTuple);
+            if constexpr(std::is_void_v<decltype(std::apply(func, std::move(args)))>){
+                std::apply(func, std::move(args));
                 callback();
             } else
-                callback(std::apply(func, argsTuple));
+                callback(std::apply(func, std::move(args)));
 
         };
     }
@@ -78,13 +108,11 @@ public:
      * the return type of the task function, as evaluated by std::invoke_result_t.
      */
     template<typename Function, typename Callback>
+        requires (!ArgumentsTuple<Callback>)
     void operator()(Function&& func, Callback&& callback){
-
-        typedef std::invoke_result_t<Function> ReturnType;
-
-        task_ = [&func, &callback] ()
+        task_ = [func = std::forward<Function>(func), callback = std::forward<Callback>(callback)] () mutable
         {
-            if constexpr(std::is_void_v<ReturnType>){
+            if constexpr(std::is_void_v<std::invoke_result_t<decltype(func)&>>){
                 func();
                 callback();
             } else
@@ -99,14 +127,14 @@ public:
      * This function template focuses on situations where the task function and its
      * arguments are provided, but there's no callback function.
      *
-     * The tuple of arguments is passed as a const reference, preventing modifications
-     * while avoiding the cost of a full copy. The function and its arguments are then
-     * enqueued as a task without a callback.
+     * The arguments are moved out of an rvalue tuple (copied out of an lvalue one) into
+     * the task, and from there into `func` when it runs.
      */
-    template<typename Function, typename... Types>
-    void operator()(Function&& func, const std::tuple<Types...>& argsTuple){
-        task_ = [&func, argsTuple](){
-            std::apply(func, argsTuple);
+    template<typename Function, typename Tuple>
+        requires ArgumentsTuple<Tuple>
+    void operator()(Function&& func, Tuple&& argsTuple){
+        task_ = [func = std::forward<Function>(func), args = DecayArguments(std::forward<Tuple>(argsTuple))]() mutable {
+            std::apply(func, std::move(args));
         };
     }
 
@@ -120,28 +148,138 @@ public:
      */
     template<typename Function>
     void operator()(Function&& func){
-        task_ = [&func](){
+        task_ = [func = std::forward<Function>(func)]() mutable {
             func();
         };
     }
 
     void Execute(){
         try{
-            status_ = STATUS_RUNNING;
+            status_.store(STATUS_RUNNING, std::memory_order_relaxed);
             task_();
-            status_ = STATUS_DONE;
         } catch(std::exception& e){
             TRACE_LOG("[EXCEPTION] %s", e.what());
         }
+        status_.store(STATUS_DONE, std::memory_order_release);
+        status_.notify_all();
     }
 
     void AssociateThread(int threadId) noexcept { threadId_ = threadId; }
     int GetThreadId() const noexcept { return threadId_; }
 
+    void SetPriority(TaskPriority priority) noexcept { priority_ = priority; }
+    TaskPriority GetPriority() const noexcept { return priority_; }
+
+    void SetNode(int node) noexcept { node_ = node; }
+    int GetNode() const noexcept { return node_; }
+
+    void SetOptions(const TaskOptions& options) noexcept {
+        priority_ = options.priority;
+        node_ = options.node;
+        name_ = options.name;
+        blocking_ = options.blocking;
+        stopToken_ = options.stopToken;
+        deadline_ = options.deadline == std::chrono::steady_clock::time_point::max() ? 0 :
+                    static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            options.deadline.time_since_epoch()).count());
+    }
+
+    const char* GetName() const noexcept { return name_; }
+
+    bool IsBlocking() const noexcept { return blocking_; }
+
+    const std::stop_token& GetStopToken() const noexcept { return stopToken_; }
+
+    // Whether the task may have to be dropped instead of run: it has a stop token or a deadline.
+    bool IsCancellable() const noexcept { return deadline_ != 0 || stopToken_.stop_possible(); }
+    bool StopRequested() const noexcept { return stopToken_.stop_requested(); }
+    // `now` as given by SteadyNanoseconds().
+    bool IsExpired(uint64_t now) const noexcept { return deadline_ != 0 && now >= deadline_; }
+
+    // Bytes of state captured by the task's callable, as counted by the pool's admission control.
+    std::size_t GetCapturedSize() const noexcept { return task_.Size(); }
+
+    TaskStatus GetStatus() const noexcept { return status_.load(std::memory_order_acquire); }
+    // Finished, either run or cancelled.
+    bool IsDone() const noexcept { return GetStatus() >= STATUS_DONE; }
+    bool IsCancelled() const noexcept { return GetStatus() == STATUS_CANCELLED; }
+
+    /**
+     * @brief Completes a task that is never going to run: stopped or expired while queued,
+     * or discarded by a cancelling shutdown.
+     *
+     * Neither the callable nor its callback are invoked; the cancel hook is, if any. Waiters
+     * are released and TaskFuture::get() throws std::future_error(broken_promise).
+     */
+    void Cancel() noexcept {
+        if(cancelHook_)
+            cancelHook_(cancelContext_);
+        status_.store(STATUS_CANCELLED, std::memory_order_release);
+        status_.notify_all();
+    }
+
+    /**
+     * @brief Called when the task is cancelled, for whatever keeps track of its completion
+     * besides the task itself (e.g. the countdown of a TaskBatch). `context` has to outlive the task.
+     */
+    void OnCancel(void (*hook)(void*) noexcept, void* context) noexcept {
+        cancelHook_ = hook;
+        cancelContext_ = context;
+    }
+
+    /**
+     * @brief Blocks until the task has been executed.
+     *
+     * When called from one of the pool's workers, the worker keeps executing other
+     * pending tasks in the meantime instead of blocking, so that tasks waiting on
+     * other tasks can neither deadlock the pool nor leave cores idle.
+     */
+    void Wait();
+
+    /**
+     * @brief Same as Wait(), giving up at the deadline. Returns whether the task is done.
+     */
+    bool WaitUntil(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * Blocks the calling thread while the task is in the given status.
+     */
+    void WaitWhile(TaskStatus status) const noexcept { status_.wait(status, std::memory_order_acquire); }
+
+    /**
+     * @brief Stores an already self-contained callable (everything captured by value).
+     */
+    template<typename Function>
+    void Bind(Function&& func){ task_ = std::forward<Function>(func); }
+
+    /**
+     * @brief Pins/unpins the ownership of the task while it is queued.
+     *
+     * The pool queues hold raw pointers (the work-stealing deques are lock-free and
+     * can only store trivially copyable items), so the shared ownership is kept in the
+     * task itself from enqueue until the worker picks it up.
+     */
+    void Retain(std::shared_ptr<Task> self) noexcept { self_ = std::move(self); }
+    std::shared_ptr<Task> Release() noexcept { return std::move(self_); }
+
+    // When the task was last enqueued (SteadyNanoseconds()), to measure its queue wait.
+    void MarkEnqueued(uint64_t now) noexcept { enqueuedAt_ = now; }
+    uint64_t GetEnqueuedAt() const noexcept { return enqueuedAt_; }
+
 private:
-    std::function<void()> task_;
+    TaskFunction task_;
+    std::shared_ptr<Task> self_;
     int threadId_{};
-    TaskStatus status_{};
+    TaskPriority priority_{PRIORITY_NORMAL};
+    int node_{-1};
+    const char* name_ = nullptr;
+    bool blocking_ = false;
+    std::atomic<TaskStatus> status_{STATUS_PENDING};
+    uint64_t enqueuedAt_{};
+    std::stop_token stopToken_;
+    uint64_t deadline_{};   // SteadyNanoseconds(), 0 for none.
+    void (*cancelHook_)(void*) noexcept = nullptr;
+    void* cancelContext_ = nullptr;
 };
 
 
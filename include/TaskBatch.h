@@ -0,0 +1,95 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TASKBATCH_H
+#define THREADPOOLLIB_TASKBATCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Task.h"
+
+/**
+ * @brief Handle to a group of tasks submitted at once through ThreadPool::CreateTasks()
+ * or ThreadPool::SubmitBatch().
+ *
+ * Allows waiting for the whole group instead of task by task.
+ */
+class TaskBatch {
+
+public:
+    TaskBatch() = default;
+
+    /**
+     * @brief Blocks until every task of the batch has been executed.
+     *
+     * Helps with pending work if called from a pool worker. The first exception thrown
+     * by a task of the batch, if any, is rethrown.
+     */
+    void Wait();
+
+    bool IsDone() const noexcept { return !state_ || state_->remaining.load(std::memory_order_acquire) <= 0; }
+    std::size_t Size() const noexcept { return tasks_.size(); }
+    const std::vector<std::shared_ptr<Task>>& GetTasks() const noexcept { return tasks_; }
+
+private:
+    friend class ThreadPool;
+
+    struct State {
+        std::atomic<int64_t> remaining{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr exception;
+    };
+
+    /**
+     * Wraps a callable of the batch so that it records its exception, if any, and
+     * accounts for its completion.
+     */
+    template<typename Function>
+    static auto Wrap(std::shared_ptr<State> state, Function&& func){
+        return [state = std::move(state), func = std::forward<Function>(func)]() mutable {
+            try {
+                func();
+            } catch(...) {
+                if(!state->failed.exchange(true, std::memory_order_acq_rel))
+                    state->exception = std::current_exception();
+            }
+            if(state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                state->remaining.notify_all();
+        };
+    }
+
+    // Cancel hook of the batch's tasks (see Task::OnCancel()): a cancelled task is done as well.
+    static void Cancelled(void* state) noexcept {
+        auto* batchState = static_cast<State*>(state);
+        if(batchState->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            batchState->remaining.notify_all();
+    }
+
+    std::shared_ptr<State> state_;
+    std::vector<std::shared_ptr<Task>> tasks_;
+};
+
+#endif //THREADPOOLLIB_TASKBATCH_H
@@ -0,0 +1,150 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TASKFUNCTION_H
+#define THREADPOOLLIB_TASKFUNCTION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Size, in bytes, of the inline storage of a TaskFunction. Callables up to this
+ * size are stored inside the Task itself; bigger ones fall back to the heap.
+ * Can be overridden at configure time (-DTHREADPOOL_TASK_INLINE_SIZE=128).
+ */
+#ifndef THREADPOOL_TASK_INLINE_SIZE
+#define THREADPOOL_TASK_INLINE_SIZE 64
+#endif
+
+/**
+ * @brief Move-only type-erased callable with small-buffer storage.
+ *
+ * Unlike std::function it does not require the callable to be copyable, and its
+ * inline buffer is sized for the lambdas the pool builds (callable + callback +
+ * argument tuple), so that in the common case no allocation happens at all.
+ */
+class TaskFunction {
+
+private:
+    static constexpr std::size_t INLINE_SIZE = THREADPOOL_TASK_INLINE_SIZE;
+    static constexpr std::size_t INLINE_ALIGN = alignof(std::max_align_t);
+
+    struct VTable {
+        void (*invoke)(void* storage);
+        void (*move)(void* destination, void* source) noexcept;
+        void (*destroy)(void* storage) noexcept;
+        std::size_t size;
+    };
+
+    template<typename F>
+    static constexpr bool IsInline = sizeof(F) <= INLINE_SIZE && alignof(F) <= INLINE_ALIGN
+                                     && std::is_nothrow_move_constructible_v<F>;
+
+    template<typename F>
+    static constexpr VTable inlineVTable_ = {
+        [](void* storage){ (*static_cast<F*>(storage))(); },
+        [](void* destination, void* source) noexcept {
+            ::new(destination) F(std::move(*static_cast<F*>(source)));
+            static_cast<F*>(source)->~F();
+        },
+        [](void* storage) noexcept { static_cast<F*>(storage)->~F(); },
+        sizeof(F)
+    };
+
+    template<typename F>
+    static constexpr VTable heapVTable_ = {
+        [](void* storage){ (**static_cast<F**>(storage))(); },
+        [](void* destination, void* source) noexcept {
+            *static_cast<F**>(destination) = *static_cast<F**>(source);
+        },
+        [](void* storage) noexcept { delete *static_cast<F**>(storage); },
+        sizeof(F)
+    };
+
+    alignas(INLINE_ALIGN) unsigned char storage_[INLINE_SIZE];
+    const VTable* vtable_ = nullptr;
+
+    static inline std::atomic<uint64_t> heapAllocations_{0};
+
+    void Reset() noexcept {
+        if(vtable_){
+            vtable_->destroy(storage_);
+            vtable_ = nullptr;
+        }
+    }
+
+public:
+    TaskFunction() noexcept = default;
+
+    template<typename Function, typename F = std::decay_t<Function>,
+             typename = std::enable_if_t<!std::is_same_v<F, TaskFunction>>>
+    TaskFunction(Function&& func){
+        if constexpr(IsInline<F>){
+            ::new(static_cast<void*>(storage_)) F(std::forward<Function>(func));
+            vtable_ = &inlineVTable_<F>;
+        } else {
+            *reinterpret_cast<F**>(storage_) = new F(std::forward<Function>(func));
+            heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+            vtable_ = &heapVTable_<F>;
+        }
+    }
+
+    TaskFunction(TaskFunction&& other) noexcept : vtable_(other.vtable_) {
+        if(vtable_){
+            vtable_->move(storage_, other.storage_);
+            other.vtable_ = nullptr;
+        }
+    }
+
+    TaskFunction& operator=(TaskFunction&& other) noexcept {
+        if(this != &other){
+            Reset();
+            if(other.vtable_){
+                other.vtable_->move(storage_, other.storage_);
+                vtable_ = other.vtable_;
+                other.vtable_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    TaskFunction(const TaskFunction&) = delete;
+    TaskFunction& operator=(const TaskFunction&) = delete;
+
+    ~TaskFunction(){ Reset(); }
+
+    void operator()(){ vtable_->invoke(storage_); }
+
+    explicit operator bool() const noexcept { return vtable_ != nullptr; }
+
+    // Size of the stored callable (captures included), inline or not.
+    std::size_t Size() const noexcept { return vtable_ ? vtable_->size : 0; }
+
+    /**
+     * Number of callables, process-wide, that did not fit into the inline buffer.
+     */
+    static uint64_t HeapAllocations() noexcept { return heapAllocations_.load(std::memory_order_relaxed); }
+};
+
+#endif //THREADPOOLLIB_TASKFUNCTION_H
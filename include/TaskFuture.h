@@ -0,0 +1,149 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TASKFUTURE_H
+#define THREADPOOLLIB_TASKFUTURE_H
+
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Task.h"
+
+/**
+ * @brief A Task that also holds the outcome of its callable.
+ *
+ * This is the shared state behind a TaskFuture. Being a Task itself, the result
+ * (or the exception) lives in the same block as the task and its control block,
+ * so submitting with a future costs no extra allocation.
+ */
+template<typename R>
+class TaskState : public Task {
+
+public:
+    /**
+     * @brief Binds the callable and its arguments, both captured by value.
+     *
+     * Any exception thrown by the callable is caught and stored, to be rethrown
+     * by TaskFuture::get().
+     */
+    template<typename Function, typename... Args>
+    void Prepare(Function&& func, Args&&... args){
+        Bind([this, func = std::forward<Function>(func), ...args = std::forward<Args>(args)]() mutable {
+            try {
+                if constexpr(std::is_void_v<R>)
+                    std::invoke(std::move(func), std::move(args)...);
+                else
+                    result_.emplace(std::invoke(std::move(func), std::move(args)...));
+            } catch(...) {
+                exception_ = std::current_exception();
+            }
+        });
+    }
+
+    R TakeResult(){
+        if(IsCancelled())
+            throw std::future_error(std::future_errc::broken_promise);
+        if(exception_)
+            std::rethrow_exception(exception_);
+        if constexpr(!std::is_void_v<R>)
+            return std::move(*result_);
+    }
+
+private:
+    typedef std::conditional_t<std::is_void_v<R>, bool, R> StoredType;
+
+    std::optional<StoredType> result_;
+    std::exception_ptr exception_;
+};
+
+/**
+ * @brief Handle to the result of a task created through ThreadPool::Submit().
+ *
+ * Mirrors the std::future interface. Waiting from inside a pool worker does not block the
+ * worker: it keeps running other pending tasks until the awaited one is done.
+ */
+template<typename R>
+class TaskFuture {
+
+public:
+    TaskFuture() noexcept = default;
+    explicit TaskFuture(std::shared_ptr<TaskState<R>> state) noexcept : state_(std::move(state)) {}
+
+    TaskFuture(TaskFuture&&) noexcept = default;
+    TaskFuture& operator=(TaskFuture&&) noexcept = default;
+    TaskFuture(const TaskFuture&) = delete;
+    TaskFuture& operator=(const TaskFuture&) = delete;
+
+    bool valid() const noexcept { return state_ != nullptr; }
+
+    bool is_ready() const {
+        CheckState();
+        return state_->IsDone();
+    }
+
+    void wait() const {
+        CheckState();
+        state_->Wait();
+    }
+
+    template<typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+        return wait_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template<typename Clock, typename Duration>
+    std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& timePoint) const {
+        CheckState();
+        auto deadline = std::chrono::steady_clock::now()
+                + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timePoint - Clock::now());
+        return state_->WaitUntil(deadline) ? std::future_status::ready : std::future_status::timeout;
+    }
+
+    /**
+     * @brief Waits for the task and returns its result, rethrowing its exception if any.
+     *
+     * As with std::future, the result can only be retrieved once.
+     */
+    R get(){
+        wait();
+        std::shared_ptr<TaskState<R>> state = std::move(state_);
+        return state->TakeResult();
+    }
+
+    // The underlying task, e.g. to query the worker it ran on.
+    std::shared_ptr<Task> GetTask() const noexcept { return state_; }
+
+private:
+    void CheckState() const {
+        if(!state_)
+            throw std::future_error(std::future_errc::no_state);
+    }
+
+    std::shared_ptr<TaskState<R>> state_;
+};
+
+#endif //THREADPOOLLIB_TASKFUTURE_H
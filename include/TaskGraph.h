@@ -0,0 +1,175 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TASKGRAPH_H
+#define THREADPOOLLIB_TASKGRAPH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Task.h"
+#include "TaskFunction.h"
+
+class ThreadPool;
+
+/**
+ * @brief Directed acyclic graph of tasks, executed on a ThreadPool.
+ *
+ * Every node keeps an atomic counter of its unfinished predecessors. When a node
+ * finishes, it decrements the counters of its successors and enqueues those that
+ * reach zero itself - from within the worker, i.e. into its own deque - so there is
+ * no central scheduler and no lock involved past the roots.
+ *
+ * A graph is built once and can be run many times: nodes and the dependency lists are
+ * kept between runs. Every run gets fresh node tasks (from the pool's slabs) and its own
+ * completion counter, which the tasks share: a run is over for the caller as soon as the
+ * last node is, while its task may still be winding down.
+ *
+ * Example, for: task 1 <--- (task 2 + task 3)
+ *
+ *     TaskGraph graph;
+ *     auto t1 = graph.AddNode(f1), t2 = graph.AddNode(f2), t3 = graph.AddNode(f3);
+ *     graph.AddDependency(t1, t2);
+ *     graph.AddDependency(t1, t3);
+ *     graph.Run(pool);
+ */
+class TaskGraph {
+
+public:
+    typedef std::size_t NodeId;
+    typedef std::chrono::nanoseconds Duration;
+
+    TaskGraph() = default;
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    /**
+     * @brief Adds a node. The callable is kept (and invoked once) for every run.
+     */
+    template<typename Function>
+    NodeId AddNode(Function&& func){
+        nodes_.emplace_back(std::make_unique<Node>(this, nodes_.size(), std::forward<Function>(func)));
+        Invalidate();
+        return nodes_.size() - 1;
+    }
+
+    /**
+     * @brief `node` will not start until `dependency` has finished.
+     */
+    void AddDependency(NodeId node, NodeId dependency);
+
+    /**
+     * @brief Runs the whole graph on the pool and returns once every node has finished.
+     *
+     * If called from one of the pool's workers, the worker takes part in the execution.
+     * The first exception thrown by a node, if any, is rethrown once the run is over; the
+     * rest of the graph still runs. A graph must not be run concurrently with itself.
+     * A cancelling shutdown of the pool fails the run with PoolShutdownError. Only the roots
+     * may be turned away by a full FULL_QUEUE_REJECT queue (QueueFullError): the other nodes
+     * are handed off by the workers finishing their dependencies (see ThreadPool::HandOff()).
+     */
+    void Run(ThreadPool& pool);
+
+    std::size_t Size() const noexcept { return nodes_.size(); }
+
+    /**
+     * @brief Number of nodes in the longest dependency chain.
+     *
+     * Throws std::logic_error if the graph has a cycle.
+     */
+    std::size_t CriticalPathLength();
+
+    /**
+     * @brief Timings of the last run, from the measured duration of every node.
+     *
+     * CriticalPathTime() is the lower bound for a run no matter how many workers are
+     * available, TotalWork() the time a single worker would need; their ratio is the
+     * average parallelism the graph exposes.
+     */
+    Duration CriticalPathTime() const noexcept { return criticalPathTime_; }
+    Duration TotalWork() const noexcept { return totalWork_; }
+    double Parallelism() const noexcept {
+        return criticalPathTime_.count() > 0 ? static_cast<double>(totalWork_.count()) / criticalPathTime_.count() : 0.0;
+    }
+
+private:
+    // Per run, shared by its node tasks: whoever brings `remaining` down to zero notifies.
+    struct RunState {
+        ThreadPool* pool;
+        std::atomic<int64_t> remaining{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr exception;
+
+        void Fail(std::exception_ptr error) noexcept {
+            if(!failed.exchange(true, std::memory_order_acq_rel))
+                exception = std::move(error);
+        }
+    };
+
+    struct Node {
+        template<typename Function>
+        Node(TaskGraph* graph, NodeId id, Function&& func) : graph(graph), id(id), func(std::forward<Function>(func)) {}
+
+        TaskGraph* graph;
+        NodeId id;
+        TaskFunction func;
+        std::vector<NodeId> successors;
+        uint32_t predecessors = 0;
+        std::atomic<uint32_t> pending{0};
+        std::shared_ptr<Task> task;     // Of the current run.
+        RunState* run = nullptr;        // Current run, kept alive by the node's task.
+        Duration duration{0};
+    };
+
+    void Invalidate() noexcept { sorted_ = false; }
+
+    // Computes (and caches) a topological order, throws on cycles.
+    void Sort();
+    void RunNode(RunState& run, NodeId id);
+
+    // Successors of a finished node whose last dependency it was are enqueued, or skipped if that fails.
+    void Release(RunState& run, NodeId id);
+
+    /**
+     * A node that is never going to run (its task was cancelled by a shutdown, or could not
+     * be enqueued) counts as finished, along with every successor left waiting only for it.
+     */
+    void Skip(RunState& run, NodeId id, std::exception_ptr error) noexcept;
+    static void Cancelled(void* node) noexcept;
+
+    void ComputeTimings();
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::vector<NodeId> order_;
+    std::vector<NodeId> roots_;
+    bool sorted_ = false;
+
+    Duration criticalPathTime_{0};
+    Duration totalWork_{0};
+};
+
+#endif //THREADPOOLLIB_TASKGRAPH_H
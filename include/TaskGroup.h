@@ -0,0 +1,162 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TASKGROUP_H
+#define THREADPOOLLIB_TASKGROUP_H
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include "MpscQueue.h"
+#include "TaskFunction.h"
+#include "ThreadPool.h"
+
+/**
+ * @brief Structured fork-join: Run() children on the pool, then Wait() for all of them.
+ *
+ * The joining thread does not just block. From a worker, the children it spawned are still on
+ * top of its own deque, so Wait() runs them right there (the ones not stolen meanwhile) and
+ * then helps with whatever else is pending. From outside the pool, Wait() claims the children
+ * no worker has started yet and runs them inline. Either way a small pool can not deadlock on
+ * recursive groups, and spawning costs one task from the pool's slabs, pushed without a lock.
+ *
+ *     long Sum(ThreadPool& pool, const Node* node){
+ *         if(node->size < 1000)
+ *             return SumSerially(node);
+ *         long left, right;
+ *         TaskGroup group(pool);
+ *         group.Run([&]{ left = Sum(pool, node->left); });
+ *         right = Sum(pool, node->right);
+ *         group.Wait();
+ *         return left + right;
+ *     }
+ */
+class TaskGroup {
+
+public:
+    explicit TaskGroup(ThreadPool& pool);
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Waits for the children if Wait() was not called: they may refer to the caller's stack. Their exceptions are dropped.
+    ~TaskGroup();
+
+    /**
+     * @brief Runs a callable as a child of the group. Children may Run() more children into
+     * the same group.
+     */
+    template<typename Function>
+    void Run(Function&& func){
+        state_->pending.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<Task> task = pool_->NewTask();
+
+        // Children spawned from outside the pool are also listed, so that Wait() can claim them.
+        Child* child = nullptr;
+        if(ThreadPool::currentPool_ == pool_){
+            task->Bind([state = state_, func = std::forward<Function>(func)]() mutable { state->Invoke(func); });
+            task->OnCancel(&TaskGroup::Cancelled, state_.get());
+        } else {
+            child = NewChild();
+            child->function = std::forward<Function>(func);
+            task->Bind([state = state_, child](){ RunChild(child); });
+            task->OnCancel(&TaskGroup::ChildCancelled, child);
+            state_->children.Push(child);
+        }
+
+        try {
+            pool_->AddTask(std::move(task));
+        } catch(...) {
+            if(child)
+                ChildCancelled(child);
+            else
+                state_->Finished();
+            throw;
+        }
+    }
+
+    /**
+     * @brief Returns once every child has finished, running children and other pending
+     * tasks meanwhile as explained above. The first exception thrown by a child, if any,
+     * is rethrown. The group can be used again afterwards.
+     *
+     * One thread at a time waits for a given group, usually the one that created it.
+     */
+    void Wait();
+
+    bool IsDone() const noexcept { return state_->pending.load(std::memory_order_acquire) <= 0; }
+
+private:
+    struct State {
+        ~State();
+
+        // Whoever brings it down to zero notifies (see ThreadPool::HelpUntilZero()).
+        std::atomic<int64_t> pending{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr exception;
+        MpscQueue children;
+
+        template<typename Function>
+        void Invoke(Function& func) noexcept {
+            try {
+                func();
+            } catch(...) {
+                if(!failed.exchange(true, std::memory_order_acq_rel))
+                    exception = std::current_exception();
+            }
+            Finished();
+        }
+
+        void Finished() noexcept {
+            if(pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                pending.notify_all();
+        }
+    };
+
+    /**
+     * A child spawned from outside the pool. Whoever claims it first, its task or Wait(),
+     * runs it; both give up their reference once done with it.
+     */
+    struct Child : MpscQueue::Node {
+        State* state;
+        std::atomic<bool> claimed{false};
+        std::atomic<int> references{2};
+        TaskFunction function;
+    };
+
+    Child* NewChild();
+    static void RunChild(Child* child) noexcept;
+    static void ReleaseChild(Child* child) noexcept;
+
+    // Cancel hooks (see Task::OnCancel()): a cancelled child is finished as well.
+    static void Cancelled(void* state) noexcept { static_cast<State*>(state)->Finished(); }
+    static void ChildCancelled(void* child) noexcept;
+
+    // Waits without rethrowing.
+    void Join();
+
+    ThreadPool* pool_;
+    std::shared_ptr<State> state_;
+};
+
+#endif //THREADPOOLLIB_TASKGROUP_H
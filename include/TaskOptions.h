@@ -0,0 +1,74 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TASKOPTIONS_H
+#define THREADPOOLLIB_TASKOPTIONS_H
+
+#include <chrono>
+#include <cstddef>
+#include <stop_token>
+
+/**
+ * Priority classes, highest first. Each class has its own shared queue; workers pick from
+ * them by weighted round-robin (see ThreadPoolOptions::priorityWeights), so higher classes
+ * are served first but lower ones are never starved.
+ */
+enum TaskPriority {
+    PRIORITY_REALTIME = 0,
+    PRIORITY_NORMAL = 1,
+    PRIORITY_BACKGROUND = 2
+};
+
+static constexpr std::size_t PRIORITY_CLASSES = 3;
+
+inline const char* PriorityName(TaskPriority priority) noexcept {
+    switch(priority){
+        case PRIORITY_REALTIME: return "realtime";
+        case PRIORITY_BACKGROUND: return "background";
+        default: return "normal";
+    }
+}
+
+/**
+ * @brief Per-submission settings, e.g. pool.Submit(TaskOptions{.priority = PRIORITY_BACKGROUND}, func).
+ */
+struct TaskOptions {
+    TaskPriority priority = PRIORITY_NORMAL;
+    int node = -1;      // NUMA node the task's data lives on, -1 for anywhere.
+
+    /**
+     * A task whose stop is requested, or whose deadline has passed, before it starts is
+     * dropped without running (STATUS_CANCELLED). Once running, it can poll both through
+     * ThreadPool::CancellationRequested().
+     */
+    std::stop_token stopToken;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    // Shown in execution traces (ThreadPool::DumpTrace()). Has to outlive the pool, e.g. a string literal.
+    const char* name = nullptr;
+
+    /**
+     * The task is going to block (file I/O, locks, ...): while it runs, a spare worker takes
+     * its place among the runnable ones, as with a ScopedBlocking around the whole task.
+     */
+    bool blocking = false;
+};
+
+#endif //THREADPOOLLIB_TASKOPTIONS_H
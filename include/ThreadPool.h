@@ -21,87 +21,811 @@
 #ifndef THREADPOOLLIB_THREADPOOL_H
 #define THREADPOOLLIB_THREADPOOL_H
 
+#include <array>
+#include <chrono>
+#include <coroutine>
 #include <thread>
 #include <vector>
 #include <queue>
+#include <memory>
+#include <optional>
 #include <functional>
 #include <mutex>
 #include <atomic>
+#include <algorithm>
 #include <exception>
+#include <ranges>
+#include <stdexcept>
+#include <unordered_map>
 #include <condition_variable>
 
 #include "Macros.h"
+#include "Arena.h"
 #include "Task.h"
+#include "TaskOptions.h"
+#include "PoolMetrics.h"
+#include "TaskFuture.h"
+#include "TaskBatch.h"
+#include "RingBuffer.h"
+#include "MpmcQueue.h"
+#include "Topology.h"
+#include "TimerHandle.h"
+#include "Tracer.h"
+#include "SlabAllocator.h"
+#include "WorkStealingDeque.h"
+
+/**
+ * SCHEDULING_SHARED_QUEUE: every task goes through the single locked queue.
+ * SCHEDULING_WORK_STEALING: tasks created from within a worker go to that worker's
+ * own lock-free deque and idle workers steal from the others. Tasks created from
+ * outside the pool still go through the shared queue.
+ */
+enum SchedulingPolicy {
+    SCHEDULING_SHARED_QUEUE = 0,
+    SCHEDULING_WORK_STEALING = 1
+};
+
+/**
+ * What a worker does when it runs out of tasks.
+ *
+ * IDLE_PARK: goes to sleep on the condition variable straight away (lowest CPU usage,
+ * every submission to an idle pool pays for a futex wake and a context switch).
+ * IDLE_SPIN: spins a fixed number of iterations (with pause instructions), then yields a
+ * few times and only then parks.
+ * IDLE_ADAPTIVE: like IDLE_SPIN, but the spin budget of each worker doubles whenever work
+ * shows up while spinning and halves whenever it has to park, so workers only burn CPU
+ * when work has been arriving recently.
+ */
+enum IdlePolicy {
+    IDLE_PARK = 0,
+    IDLE_SPIN = 1,
+    IDLE_ADAPTIVE = 2
+};
+
+/**
+ * Storage of the shared queues (one per priority class).
+ *
+ * QUEUE_MUTEX: growable ring buffers guarded by the pool's mutex. Unbounded.
+ * QUEUE_LOCK_FREE: bounded lock-free MPMC ring buffers of `queueCapacity` tasks each. The
+ * mutex is only taken to wake up a sleeping worker or a producer waiting for room.
+ */
+enum QueueBackend {
+    QUEUE_MUTEX = 0,
+    QUEUE_LOCK_FREE = 1
+};
+
+/**
+ * What adding a task into a full bounded queue does. Pool workers never sleep waiting for
+ * room, they run other tasks meanwhile, so that a full pool can not deadlock on itself.
+ *
+ * FULL_QUEUE_BLOCK: sleeps until a worker takes a task out of the queue.
+ * FULL_QUEUE_SPIN: yields in a loop until there is room.
+ * FULL_QUEUE_REJECT: throws QueueFullError; a group of tasks is either fully added or rejected.
+ */
+enum FullQueuePolicy {
+    FULL_QUEUE_BLOCK = 0,
+    FULL_QUEUE_SPIN = 1,
+    FULL_QUEUE_REJECT = 2
+};
+
+/**
+ * How ThreadPool::Shutdown() deals with the tasks not started yet.
+ *
+ * DRAIN_ALL: runs every queued task, and those they spawn, before stopping.
+ * DRAIN_CANCEL: only lets running tasks finish; queued ones are cancelled (see Task::Cancel()).
+ */
+enum DrainMode {
+    DRAIN_ALL = 0,
+    DRAIN_CANCEL = 1
+};
+
+/**
+ * @brief Thrown when a task is submitted from outside a pool that is shutting down.
+ */
+class PoolShutdownError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Thrown when a task is rejected because its queue is full.
+ */
+class QueueFullError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct ThreadPoolOptions {
+    unsigned int threads = std::thread::hardware_concurrency();
+    SchedulingPolicy scheduling = SCHEDULING_WORK_STEALING;
+    IdlePolicy idlePolicy = IDLE_ADAPTIVE;
+    uint32_t spinIterations = 4096;     // Maximum spin budget, in pause iterations.
+    uint32_t yieldIterations = 8;       // Yields between spinning and parking.
+
+    /**
+     * Weighted round-robin over the priority classes (realtime, normal, background): out of
+     * every 16 + 4 + 1 tasks taken from the shared queues while all classes have work, 16
+     * are realtime, 4 normal and 1 background. Weights of 0 are taken as 1.
+     */
+    std::array<uint32_t, PRIORITY_CLASSES> priorityWeights = {16, 4, 1};
+
+    /**
+     * Elastic mode, enabled when maxThreads > 0: the pool adds workers (up to maxThreads) while
+     * tasks wait longer than scaleUpWait in the queues, and workers parked for longer than
+     * idleTimeout retire (down to minThreads). `threads` is the initial size.
+     */
+    unsigned int minThreads = 1;
+    unsigned int maxThreads = 0;
+    std::chrono::microseconds scaleUpWait{1000};
+    std::chrono::milliseconds idleTimeout{5000};
+
+    /**
+     * Blocking compensation (see ScopedBlocking and TaskOptions::blocking): at most that many
+     * spare workers, on top of the pool's size, stand in for workers blocked in the meantime.
+     * 0 turns compensation off.
+     */
+    unsigned int maxSpareThreads = std::thread::hardware_concurrency();
+
+    // Worker placement, see AffinityPolicy. `cpus` is only used by AFFINITY_EXPLICIT.
+    AffinityPolicy affinity = AFFINITY_NONE;
+    std::vector<int> cpus = {};
+
+    // Shared queues, see QueueBackend. Capacity (per priority class) is rounded up to a power of two.
+    QueueBackend queueBackend = QUEUE_MUTEX;
+    std::size_t queueCapacity = 4096;
+    FullQueuePolicy fullQueuePolicy = FULL_QUEUE_BLOCK;
+
+    /**
+     * Admission control: at most maxPendingTasks tasks, holding at most maxPendingBytes bytes of
+     * captured state (callables and their arguments), may be waiting in the queues; 0 for no
+     * limit. Beyond that, submitting waits for room and TrySubmit() gives up.
+     */
+    std::size_t maxPendingTasks = 0;
+    std::size_t maxPendingBytes = 0;
+
+    // Resolution of ScheduleAfter(), ScheduleAt() and ScheduleEvery(): timers fire on the first tick at or past their time.
+    std::chrono::microseconds timerTick{1000};
+
+    /**
+     * Execution tracing (see ThreadPool::DumpTrace()), only available when built with
+     * THREADPOOL_TRACING: whether it starts on, and how many events each thread keeps.
+     */
+    bool tracing = false;
+    std::size_t traceCapacity = 32768;
+};
+
+namespace pool {
+    class PromiseBase;
+}
 
 class ThreadPool {
 
 private:
+    friend class Task;
+    friend class TaskGraph;
+    friend class TaskBatch;
+    friend class Strand;
+    friend class TaskGroup;
+    friend class ScopedBlocking;
+    friend class Pipeline;
+    friend class pool::PromiseBase;
+
     /**
      * Thread-safe.
      */
     typedef std::mutex Mutex;
     typedef std::atomic<bool> AtomicBool;
+    typedef std::atomic<int64_t> AtomicCounter;
     typedef std::condition_variable ConditionVariable;
     typedef std::unique_lock<Mutex> UniqueLock;
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    /**
+     * THREADPOOL_METRICS and THREADPOOL_TRACING change the layout of the pool. They are part
+     * of the type of the constructor everyone ends up calling, so that code built with other
+     * values than the library fails to link instead of silently disagreeing on that layout.
+     */
+    template<int Metrics, int Tracing>
+    struct BuildConfig {};
+    typedef BuildConfig<THREADPOOL_METRICS, THREADPOOL_TRACING> BuildFlags;
+
+    ThreadPool(const ThreadPoolOptions& options, BuildFlags);
+
+    /**
+     * Per-worker state. Over-aligned so that two workers never share a cache line.
+     *
+     * A Worker is a slot: it outlives the thread running it, so that thieves can keep
+     * looking at it while the pool shrinks, and it is reused when the pool grows again.
+     */
+    struct alignas(64) Worker {
+        WorkStealingDeque<Task*> tasks;
+        uint32_t stealSeed;
+        uint32_t spinBudget;
+        uint32_t localStreak;
+        std::array<uint32_t, PRIORITY_CLASSES> priorityCredits;    // Weighted round-robin, lock-free queues only.
+        int cpu = -1;                   // Where the worker is pinned (-1: not pinned, so locality unknown).
+        int node = -1;
+        int l3 = -1;
+        AtomicBool retiring{false};     // The thread exits once its own deque is drained.
+        AtomicBool exited{false};       // ...and sets this right before returning.
+        std::atomic<uint32_t> blocking{0};  // Nesting depth of the blocking regions it is in, only written by its thread.
+
+        // Guarded by resizeMutex_.
+        std::thread thread;
+        bool active = false;
+        bool spare = false;             // Started to stand in for a blocked worker.
+
+        // Scratch memory for the tasks it runs, see CurrentArena(). Only used by its thread.
+        Arena arena;
+        bool localized = false;         // Deque array moved to the pinned thread's node, see ExecuteTask().
+#if THREADPOOL_METRICS
+        WorkerMetrics metrics;
+#endif
+    };
 
     /**
      * Data structures
      */
-    typedef std::vector<std::thread> ThreadPoolVector;
-    typedef std::queue<std::shared_ptr<Task>> TasksQueue;
+    typedef std::vector<std::unique_ptr<Worker>> WorkersVector;
+    typedef std::vector<std::unique_ptr<Worker*[]>> SlotArrays;
+    typedef RingBuffer<Task*> TasksQueue;
+    typedef std::array<TasksQueue, PRIORITY_CLASSES> PriorityQueues;
+    typedef std::array<std::unique_ptr<MpmcQueue<Task*>>, PRIORITY_CLASSES> BoundedQueues;
+
+    /**
+     * Tasks submitted with a node hint from outside that node. Workers of the node take
+     * from it right after their own deque; workers of other nodes only when they could
+     * neither find nor steal anything else.
+     */
+    struct alignas(64) NodeQueue {
+        Mutex mutex;
+        TasksQueue tasks;
+        AtomicCounter size{0};
+    };
+    typedef std::vector<std::unique_ptr<NodeQueue>> NodeQueues;
     typedef std::unordered_map<std::thread::id, int> ThreadIdMap;
 
-    uint8_t poolSize_;
-    ThreadPoolVector pool_;
-    TasksQueue tasks_;
+    SchedulingPolicy schedulingPolicy_;
+    IdlePolicy idlePolicy_;
+    uint32_t spinIterations_;
+    uint32_t yieldIterations_;
+    PriorityQueues tasks_;
+    NodeQueues nodeQueues_;
     Mutex mutex_;
     AtomicBool poolActive_ = true;
     ConditionVariable cv_;
+
+    /**
+     * QUEUE_LOCK_FREE backend: boundedTasks_ replaces tasks_. Room in a queue is reserved on
+     * priorityTasks_ before pushing, so a push never finds it full. Producers waiting for
+     * room sleep on roomCv_ (with mutex_), and are only notified when there are any.
+     */
+    QueueBackend queueBackend_;
+    FullQueuePolicy fullQueuePolicy_;
+    int64_t queueCapacity_;
+    BoundedQueues boundedTasks_;
+    ConditionVariable roomCv_;
+    AtomicCounter waitingProducers_ = 0;
+
+    /**
+     * Admission control. Tasks and bytes are reserved before a task is queued and given back
+     * when a worker takes it out; producers waiting for room use roomCv_ as well.
+     */
+    bool admissionControl_;
+    int64_t maxPendingTasks_;
+    int64_t maxPendingBytes_;
+    AtomicCounter admittedTasks_ = 0;
+    AtomicCounter admittedBytes_ = 0;
+    std::atomic<uint64_t> rejectedTasks_ = 0;
+
+    // Tasks dropped instead of run, see TaskOptions::stopToken.
+    std::atomic<uint64_t> cancelledTasks_ = 0;
+    std::atomic<uint64_t> expiredTasks_ = 0;
+
+    /**
+     * Tasks submitted and not finished yet, queued or running. Whoever brings it down to zero
+     * notifies idleCv_ (with mutex_), only if WaitIdle() or a shutdown is waiting on it.
+     */
+    AtomicCounter unfinishedTasks_ = 0;
+    AtomicCounter idleWaiters_ = 0;
+    ConditionVariable idleCv_;
+
+    /**
+     * Set once Shutdown() starts: tasks from outside the pool are rejected from then on.
+     * shutDown_, guarded by shutdownMutex_, once it is over.
+     *
+     * submitting_ counts the producers from outside the pool between their stopping_ check
+     * and the end of their push (see Submission). Both sequentially consistent: either a
+     * producer sees the flag, or Shutdown() waits for its task to be queued before draining
+     * or sweeping the queues.
+     */
+    AtomicBool stopping_ = false;
+    AtomicCounter submitting_ = 0;
+    Mutex shutdownMutex_;
+    bool shutDown_ = false;
+
+    /**
+     * Delayed and periodic tasks. timerThread_, started along with the first timer, sleeps
+     * until the wheel's next event and hands the due timers' tasks to the queues. Wheel ticks
+     * are counted from timerEpoch_.
+     */
+    std::shared_ptr<TimerQueue> timers_;
+    std::thread timerThread_;       // Guarded by timers_->mutex.
+    TimePoint timerEpoch_;
+    std::chrono::nanoseconds timerTick_;
+
+    /**
+     * Worker slots. Readers (thieves, metrics) load slotCount_ and then slots_, both with
+     * acquire, and never look past the count they loaded. Growing publishes a bigger copy of
+     * the array before the new count; replaced arrays are kept until the pool goes away,
+     * as are the Workers themselves.
+     *
+     * Everything else about the pool's size (starting, retiring and joining threads, the
+     * owning containers and threadIdMap_) is guarded by resizeMutex_, which is always taken
+     * before mutex_, never the other way around.
+     */
+    std::atomic<Worker**> slots_ = nullptr;
+    std::atomic<std::size_t> slotCount_ = 0;
+    std::atomic<std::size_t> activeWorkers_ = 0;
+    std::size_t slotCapacity_ = 0;
+    SlotArrays slotArrays_;
+    WorkersVector workers_;
     ThreadIdMap threadIdMap_;
+    mutable Mutex resizeMutex_;
+
+    bool elastic_;
+    std::size_t minWorkers_;
+    std::size_t maxWorkers_;
+    uint64_t scaleUpWait_;
+    std::chrono::milliseconds idleTimeout_;
+    std::atomic<uint64_t> lastScaleUp_ = 0;
+
+    /**
+     * Blocking compensation. blockedWorkers_ counts the workers inside a blocking region:
+     * while there are fewer spare workers than that, and fewer than maxSpareWorkers_, one
+     * more is started; the surplus retires as regions end. spareWorkers_ is only written
+     * under resizeMutex_, compensations_ counts the spares ever started.
+     */
+    std::size_t maxSpareWorkers_;
+    AtomicCounter blockedWorkers_ = 0;
+    AtomicCounter spareWorkers_ = 0;
+    std::atomic<uint64_t> compensations_ = 0;
+
+#if THREADPOOL_TRACING
+    Tracer tracer_;
+    AtomicBool tracing_;
+#endif
+
+    // Machine layout, and the CPU of every worker slot (slot i on placement_[i % size]) if pinned.
+    Topology topology_;
+    std::vector<int> placement_;
 
     /**
-     * @brief EmplaceTaskImpl function template.
+     * Tasks (together with their shared_ptr control block) are carved from this
+     * allocator's per-thread slabs instead of the global heap.
+     */
+    SlabAllocator* slab_;
+
+    /**
+     * pendingTasks_ counts the tasks sitting in any queue (shared or per-worker), it is
+     * what sleeping workers wait on. sharedTasks_ mirrors the size of all the shared queues
+     * together so that workers can skip the lock when they are empty, priorityTasks_ the
+     * size of each one of them.
+     */
+    AtomicCounter pendingTasks_ = 0;
+    AtomicCounter sharedTasks_ = 0;
+    AtomicCounter sleepingWorkers_ = 0;
+    std::array<AtomicCounter, PRIORITY_CLASSES> priorityTasks_{};
+
+    /**
+     * Weighted round-robin state, guarded by the mutex: a class is served while it has
+     * credits left, and all credits are refilled once no class with work has any.
+     * Lock-free queues keep the same state per worker instead (Worker::priorityCredits).
+     */
+    std::array<uint32_t, PRIORITY_CLASSES> priorityWeights_;
+    std::array<uint32_t, PRIORITY_CLASSES> priorityCredits_;
+
+    /**
+     * A worker with work in its own deque still serves the shared queues once every
+     * LOCAL_BURST tasks, so that lower priority classes waiting there are not starved by
+     * locally spawned work.
+     */
+    static constexpr uint32_t LOCAL_BURST = 32;
+
+    /**
+     * Identifies the pool and worker the calling thread belongs to, if any.
+     */
+    static thread_local ThreadPool* currentPool_;
+    static thread_local int currentWorker_;
+
+    // Task being run by the calling thread (any pool), if any.
+    static thread_local Task* currentTask_;
+
+    // Set by HandOff() for the AddTask() it calls, which takes it back first thing.
+    static thread_local bool handingOff_;
+
+    /**
+     * @brief Adds a task into the pool.
      *
-     * This function template manages the addition of tasks (encapsulated in std::function objects)
-     * into the task queue. It makes use of perfect forwarding to preserve the "value category"
-     * of passed tasks and directly emplaces them into the queue, avoiding unnecessary copy or
-     * move operations.
+     * If called from one of this pool's workers (i.e. a task spawning other tasks) and the pool
+     * is work-stealing, a normal priority task is pushed into that worker's own deque without
+     * any locking. Otherwise it goes into the shared queue of its priority class, under the mutex
+     * or, with the lock-free backend, without taking it at all (unless the queue is full and
+     * the full queue policy is to block).
      *
-     * The usage of a mutex ensures thread-safety during the task emplacement into the queue. It
-     * guarantees that only one thread can modify the task queue at any given moment, effectively
-     * preventing race conditions.
+     * A sleeping worker is only notified if there is one; busy pools never touch the
+     * condition variable.
+     *
+     * With admission control, waits for room until the deadline (forever without one).
+     * Returns false if the task was rejected.
+     */
+    bool AddTask(std::shared_ptr<Task> task, const TimePoint* deadline = nullptr);
+
+    /**
+     * @brief AddTask() for tasks that carry on the work of a running one (e.g. the next
+     * item of a Pipeline stage), which can not be dropped: from a worker, FULL_QUEUE_REJECT
+     * does not apply and the worker runs other tasks until there is room.
+     */
+    void HandOff(std::shared_ptr<Task> task);
+
+    /**
+     * @brief Adds a whole group of tasks with a single lock acquisition (none from a worker
+     * of a work-stealing pool), then wakes up at most as many sleeping workers as tasks.
+     * All the tasks of a group share the same priority, and are admitted together.
+     */
+    void AddTasks(const std::vector<std::shared_ptr<Task>>& tasks);
+
+    /**
+     * @brief Reserves room for `tasks` tasks holding `bytes` bytes, waiting until the deadline
+     * (forever without one). A pool worker runs other tasks while waiting instead of sleeping.
+     *
+     * A request bigger than the limits on its own is admitted once the queues are empty.
      */
-    template<typename Task>
-    void AddTask(Task&& task){
-        UniqueLock mtxLock(mutex_);
-        tasks_.emplace(std::forward<Task>(task));
-        cv_.notify_one();
+    bool Admit(int64_t tasks, int64_t bytes, const TimePoint* deadline);
+    bool ReserveAdmission(int64_t tasks, int64_t bytes) noexcept;
+
+    // Gives back the room of a task taken out of the queues.
+    void Discharge(const Task* task);
+
+    /**
+     * @brief Registers a submission of `count` tasks for as long as it lives, throwing
+     * PoolShutdownError if the pool is stopping. Nothing for the pool's own workers.
+     */
+    class Submission {
+    public:
+        Submission(ThreadPool& pool, int64_t count);
+        ~Submission();
+
+        Submission(const Submission&) = delete;
+        Submission& operator=(const Submission&) = delete;
+
+    private:
+        AtomicCounter* submitting_ = nullptr;
+    };
+
+    // Accounts for `count` tasks that finished, or will never run.
+    void TasksFinished(int64_t count);
+
+    // Waits until no task is queued nor running, or until the deadline. Returns whether it is idle.
+    bool WaitIdleUntil(const TimePoint* deadline);
+
+    /**
+     * @brief Drains for as long as the mode and the deadline allow, then stops and joins every
+     * worker and cancels whatever is still queued. Returns whether nothing had to be cancelled.
+     */
+    bool ShutdownUntil(DrainMode mode, const TimePoint* deadline);
+
+    // Wakes up producers waiting for room, if any.
+    void NotifyRoom();
+
+    // Wheel tick a time point falls in, rounded up for expiries so that no timer fires early.
+    uint64_t TimerTick(TimePoint time, bool roundUp) const noexcept;
+
+    /**
+     * @brief Allocates a timer for `func`, from the pool's slabs.
+     */
+    template<typename Function>
+    std::shared_ptr<TimerHandle::State> NewTimer(const TaskOptions& options, Function&& func){
+        std::shared_ptr<TimerHandle::State> state =
+                std::allocate_shared<TimerHandle::State>(PooledAllocator<TimerHandle::State>(slab_));
+        state->queue = timers_;
+        state->function = std::forward<Function>(func);
+        state->options = options;
+        return state;
     }
 
     /**
-     * @brief Creates a predicate for checking if a container is empty or if a pool is active.
+     * @brief Arms a timer to first fire at `time`, then every `period` ticks unless 0, starting the
+     * timer thread if needed. Throws PoolShutdownError once a shutdown has started.
+     */
+    TimerHandle AddTimer(TimePoint time, uint64_t period, std::shared_ptr<TimerHandle::State> state);
+
+    // Links a timer into the wheel, waking up the timer thread if it sleeps past it. timers_->mutex must be held.
+    void ArmTimer(const std::shared_ptr<TimerHandle::State>& state, uint64_t expiry);
+
+    // Periodic timers, after a run: armed again for the next period still ahead, unless cancelled.
+    void RearmTimer(const std::shared_ptr<TimerHandle::State>& state);
+
+    // Hands a due timer to the queues, as a task running its callable.
+    void FireTimer(const std::shared_ptr<TimerHandle::State>& state);
+
+    // Timer thread's loop.
+    void RunTimers();
+
+    // Drops every timer and joins the timer thread; no timer can be set afterwards.
+    void StopTimers();
+
+    // Wakes up to `count` sleeping workers. Must be called with the mutex held.
+    void WakeWorkers(int64_t count);
+
+    /**
+     * @brief Lock-free backend: adds `count` tasks of a priority class into its bounded
+     * queue, waiting for room or throwing QueueFullError as the full queue policy says.
+     * Hand-offs from a worker (see HandOff()) wait, helping, even if the policy is to reject.
+     */
+    void PushBounded(Task* const* tasks, int64_t count, TaskPriority priority, bool handOff = false);
+
+    // Reserves room for `count` more tasks in the bounded queue of a priority class.
+    bool ReserveBounded(TaskPriority priority, int64_t count) noexcept;
+
+    // Lock-free counterpart of PopShared().
+    Task* PopBounded(int workerId);
+
+    /**
+     * @brief Allocates an empty Task, control block included, from the pool's slabs.
+     */
+    std::shared_ptr<Task> NewTask(){
+        return std::allocate_shared<Task>(PooledAllocator<Task>(slab_));
+    }
+
+    // Type of the value Submit(func, args...) hands back through its future.
+    template<typename Function, typename... Args>
+    using SubmitResult = std::decay_t<std::invoke_result_t<std::decay_t<Function>, std::decay_t<Args>...>>;
+
+    /**
+     * @brief Builds the task behind Submit(): callable, arguments and room for the result, all
+     * in a single block from the pool's slabs.
+     */
+    template<typename Function, typename... Args>
+    std::shared_ptr<TaskState<SubmitResult<Function, Args...>>> NewTaskState(const TaskOptions& options, Function&& func, Args&&... args){
+        typedef SubmitResult<Function, Args...> ReturnType;
+
+        std::shared_ptr<TaskState<ReturnType>> state =
+                std::allocate_shared<TaskState<ReturnType>>(PooledAllocator<TaskState<ReturnType>>(slab_));
+        state->Prepare(std::forward<Function>(func), std::forward<Args>(args)...);
+        state->SetOptions(options);
+        return state;
+    }
+
+    template<typename Function, typename... Args>
+    std::optional<TaskFuture<SubmitResult<Function, Args...>>> SubmitUntil(TimePoint deadline, const TaskOptions& options,
+                                                                          Function&& func, Args&&... args){
+        auto state = NewTaskState(options, std::forward<Function>(func), std::forward<Args>(args)...);
+        if(!AddTask(state, &deadline))
+            return std::nullopt;
+        return TaskFuture<SubmitResult<Function, Args...>>(std::move(state));
+    }
+
+    /**
+     * @brief Creates a task out of a self-contained callable and adds it into the pool.
+     */
+    template<typename Function>
+    void Spawn(Function&& func){
+        std::shared_ptr<Task> task = NewTask();
+        task->Bind(std::forward<Function>(func));
+        AddTask(std::move(task));
+    }
+
+    /**
+     * @brief Splits [begin, end) in chunks of `grain` indices and runs chunkBody(chunkBegin, chunkEnd)
+     * on every one of them.
      *
-     * Returns a lambda function as wrapper of the predicate.
+     * Chunks are handed out dynamically through an atomic counter to the calling thread and
+     * to at most one helper task per worker, so a whole loop enqueues O(workers) tasks no
+     * matter how many iterations it has. A grain of 0 picks one adaptively. Returns once
+     * every chunk has run; the first exception thrown by the body is rethrown here.
      */
-    template<typename T, typename V>
-    std::function<bool()> MutexLockPredicate(const T& cont, const V& poolActive){
-        auto wrapper = std::function<bool()>();
-        try {
-            wrapper = [&cont, &poolActive](){
-                return !cont.empty() || !poolActive;
-            };
-        } catch(const std::exception& e){
-            printf("[Exception] %s", e.what());
-        }
-        return std::move(wrapper);
+    template<typename Index, typename ChunkBody>
+    void ParallelChunks(Index begin, Index end, std::size_t grain, const ChunkBody& chunkBody);
+
+    // Threads that can take part in a parallel loop started from the calling thread.
+    std::size_t Participants() const noexcept { return GetWorkerCount() + (currentPool_ == this ? 0 : 1); }
+
+    // Chunk size actually used for `total` iterations when `grain` is requested (0: adaptive).
+    std::size_t EffectiveGrain(std::size_t total, std::size_t grain) const noexcept {
+        return grain > 0 ? grain : std::max<std::size_t>(1, total / (Participants() * 4));
+    }
+
+    Worker& WorkerAt(int workerId) const noexcept { return *slots_.load(std::memory_order_acquire)[workerId]; }
+
+    /**
+     * @brief Starts a worker thread, on a free slot if there is one. resizeMutex_ must be held.
+     */
+    Worker& StartWorker();
+
+    /**
+     * @brief Lets a worker go: it exits once done with its current task and its own deque.
+     * resizeMutex_ must be held, and mutex_ taken afterwards to notify if it may be parked.
+     */
+    void Retire(Worker& worker);
+
+    /**
+     * @brief Joins the threads of retired workers that already exited, freeing their slots.
+     * resizeMutex_ must be held.
+     */
+    void ReapWorkers();
+
+    /**
+     * @brief Elastic mode: adds a worker if there is room, at most once every scaleUpWait.
+     *
+     * Called (without holding any lock) whenever a task is seen waiting for too long.
+     */
+    void ScaleUp();
+
+    // Elastic mode: a worker parked for too long retires, unless the pool is at its minimum.
+    bool TryRetire(Worker& worker);
+
+    /**
+     * @brief Blocking regions of the calling worker (see ScopedBlocking), which may nest.
+     *
+     * Entering its outermost one starts a spare worker if there are fewer spares than
+     * blocked workers; leaving it retires a spare if there are more. Compensation is best
+     * effort: no spare is started if the thread can not be created.
+     */
+    void BeginBlocking(int workerId) noexcept;
+    void EndBlocking(int workerId) noexcept;
+
+    // Whether a task spawned by the calling thread can go into its own deque.
+    bool PushesLocally(TaskPriority priority, int node) const noexcept {
+        return schedulingPolicy_ == SCHEDULING_WORK_STEALING && currentPool_ == this && priority == PRIORITY_NORMAL &&
+               (node < 0 || WorkerAt(currentWorker_).node == node);
+    }
+
+    // Whether a node hint refers to one of the machine's nodes.
+    bool IsNode(int node) const noexcept { return node >= 0 && static_cast<std::size_t>(node) < nodeQueues_.size(); }
+
+    void PushToNode(const std::vector<Task*>& tasks, int node);
+    Task* PopFromNode(int node);
+
+    /**
+     * @brief Retrieves the next task for a worker.
+     *
+     * Own deque first (most recently spawned, hot in cache), then the shared queues and
+     * finally tries to steal from the other workers. Realtime tasks in the shared queue go
+     * before the own deque, and so do the other shared classes once every LOCAL_BURST tasks.
+     * The queue of the worker's node goes right after its own deque, other nodes' last.
+     */
+    Task* NextTask(int workerId);
+    /**
+     * Victims sharing the thief's L3 cache are tried first, then those on its node and only
+     * then the rest (a single pass when the thief's placement is unknown).
+     */
+    Task* StealTask(int workerId);
+
+    // Takes a task from the shared queues, by weighted round-robin over the priority classes.
+    Task* PopShared(int workerId);
+
+    /**
+     * @brief Busy-waits for a task, according to the idle policy, before the worker parks.
+     *
+     * Spinning workers are not counted as sleeping, so submissions don't notify them.
+     */
+    Task* SpinForTask(int workerId);
+
+    // Records an event of the calling thread if tracing is on. Compiled out without THREADPOOL_TRACING.
+    void Trace([[maybe_unused]] TraceEventType type, [[maybe_unused]] const Task* task){
+#if THREADPOOL_TRACING
+        if(tracing_.load(std::memory_order_relaxed))
+            tracer_.Record(type, task ? task->GetName() : nullptr, reinterpret_cast<uintptr_t>(task),
+                           currentPool_ == this ? currentWorker_ : -1);
+#endif
     }
 
+    // Hands a dequeued task its worker and runs it, dropping the queue's ownership afterwards.
+    void RunTask(Task* task, int workerId);
+
+    /**
+     * @brief Waits until done() holds, or until the deadline if there is one.
+     *
+     * Pool workers don't just block here: they keep running pending tasks of their pool
+     * meanwhile. Once there is nothing left to run, block(isWorker) is given the chance to
+     * put the thread to sleep until done() may have changed; it returns false when it can't,
+     * in which case the thread backs off and polls.
+     *
+     * Returns whether done() holds.
+     */
+    template<typename Done, typename Block>
+    static bool HelpUntil(const Done& done, const Block& block, const TimePoint* deadline);
+
+    /**
+     * @brief Waits until the given task is done, or until the deadline if there is one.
+     *
+     * Workers only block once the awaited task is already being executed by someone else.
+     */
+    static bool HelpUntilDone(Task& task, const TimePoint* deadline);
+
+    /**
+     * @brief Waits, helping if the caller is a worker, until the counter drops to zero.
+     *
+     * Whoever brings the counter down to zero must notify_all() on it.
+     */
+    static void HelpUntilZero(AtomicCounter& counter);
+
 public:
-    explicit ThreadPool(uint8_t num);
+    /**
+     * @brief Awaitable returned by Schedule(): suspends the coroutine and enqueues its
+     * resumption as a task of the pool.
+     *
+     * If a cancelling shutdown drops the task, the coroutine is resumed right away on the
+     * shutting down thread and the co_await throws PoolShutdownError, so that whoever
+     * awaits the coroutine is released.
+     */
+    struct ScheduleAwaiter {
+        ThreadPool* pool;
+        TaskOptions options;
+        std::coroutine_handle<> handle = nullptr;
+        bool cancelled = false;
 
-    // Ensures all running threads are properly terminated upon the pool's destruction.
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> awaiting){
+            handle = awaiting;
+            std::shared_ptr<Task> task = pool->NewTask();
+            task->Bind([awaiting](){ awaiting.resume(); });
+            // The awaiter lives in the suspended frame, until the coroutine is resumed either way.
+            task->OnCancel(&ScheduleAwaiter::Cancelled, this);
+            task->SetPriority(options.priority);
+            task->SetNode(options.node);
+            pool->AddTask(std::move(task));
+        }
+        void await_resume() const {
+            if(cancelled)
+                throw PoolShutdownError("ThreadPool is shutting down");
+        }
+
+        static void Cancelled(void* context) noexcept {
+            ScheduleAwaiter* awaiter = static_cast<ScheduleAwaiter*>(context);
+            awaiter->cancelled = true;
+            // Exceptions of the coroutine end up in its promise, never out of resume().
+            awaiter->handle.resume();
+        }
+    };
+
+    explicit ThreadPool(unsigned int num, SchedulingPolicy policy = SCHEDULING_WORK_STEALING)
+        : ThreadPool(ThreadPoolOptions{.threads = num, .scheduling = policy}) {}
+    explicit ThreadPool(const ThreadPoolOptions& options) : ThreadPool(options, BuildFlags{}) {}
+
+    // Ensures all running threads are properly terminated upon the pool's destruction: Shutdown(DRAIN_ALL).
     ~ThreadPool();
 
+    /**
+     * @brief Blocks (without spinning) until no task is queued nor running.
+     *
+     * Tasks spawned by running tasks are waited for as well. Can not be called from
+     * one of the pool's workers, whose own task would never finish meanwhile.
+     */
+    void WaitIdle();
+
+    /**
+     * @brief Stops the pool: tasks from outside the pool are rejected with PoolShutdownError
+     * from now on, queued tasks are run or cancelled as the mode says, then every worker is
+     * joined. Running tasks always finish.
+     *
+     * Returns once the workers are gone; further calls do nothing. Can not be called from
+     * one of the pool's workers.
+     */
+    void Shutdown(DrainMode mode = DRAIN_ALL);
+
+    /**
+     * @brief Shutdown(DRAIN_ALL), cancelling whatever is still queued once `timeout` is over.
+     *
+     * @return Whether every task ran (nothing was cancelled).
+     */
+    template<typename Rep, typename Period>
+    bool ShutdownFor(std::chrono::duration<Rep, Period> timeout){
+        TimePoint deadline = std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout);
+        return ShutdownUntil(DRAIN_ALL, &deadline);
+    }
+
     /**
      * @brief Disable copy and move semantics.
      *
@@ -114,8 +838,290 @@ public:
     ThreadPool(ThreadPool&&) = delete;
     ThreadPool& operator=(ThreadPool&&) = delete;
 
-    // Executes a task. To be run by threads in the pool.
-    void ExecuteTask();
+    // Executes tasks. To be run by threads in the pool.
+    void ExecuteTask(int workerId);
+
+    /**
+     * @brief Grows or shrinks the pool to `count` workers.
+     *
+     * New workers start right away. Retired workers finish the task they are running and
+     * whatever is left in their own deque, then exit; Resize() does not wait for them (so it
+     * can be called from a task), their threads are joined later on. The calling worker is
+     * never the one retired. In elastic mode the pool keeps adjusting its size afterwards,
+     * within [minThreads, maxThreads].
+     *
+     * Throws std::invalid_argument when `count` is 0: a pool always keeps one worker.
+     */
+    void Resize(std::size_t count);
+
+    // Workers currently running (retired ones that have not exited yet are not included).
+    std::size_t GetWorkerCount() const noexcept { return activeWorkers_.load(std::memory_order_relaxed); }
+
+    const Topology& GetTopology() const noexcept { return topology_; }
+
+    // Worker id of one of the pool's threads, -1 if the thread does not belong to the pool.
+    int GetWorkerId(std::thread::id threadId) const;
+
+    /**
+     * @brief Worker id of the calling thread in the pool it belongs to (see CurrentPool()), -1
+     * if it is not a worker. Ids are in [0, number of worker slots), a thread-local read.
+     */
+    static int CurrentWorker() noexcept { return currentWorker_; }
+    static ThreadPool* CurrentPool() noexcept { return currentPool_; }
+
+    /**
+     * @brief Scratch arena of the calling worker, for temporary buffers that would otherwise be
+     * malloc'ed by every task (see Arena). Threads that are not workers get one of their own.
+     *
+     *     Arena::Scope scratch(ThreadPool::CurrentArena());
+     *     float* buffer = scratch.AllocateArray<float>(samples);
+     */
+    static Arena& CurrentArena() noexcept {
+        if(currentPool_)
+            return currentPool_->WorkerAt(currentWorker_).arena;
+        static thread_local Arena arena;
+        return arena;
+    }
+
+    /**
+     * @brief For a running task to poll: whether its stop has been requested or its deadline
+     * has passed (see TaskOptions). Always false outside of a task.
+     */
+    static bool CancellationRequested() noexcept {
+        return currentTask_ && (currentTask_->StopRequested() || currentTask_->IsExpired(SteadyNanoseconds()));
+    }
+
+    // Stop token of the running task, e.g. to hand it over to std::condition_variable_any waits.
+    static std::stop_token CurrentStopToken() noexcept { return currentTask_ ? currentTask_->GetStopToken() : std::stop_token(); }
+
+    // Workers currently parked on the condition variable (spinning ones are not included).
+    int64_t GetSleepingWorkers() const noexcept { return sleepingWorkers_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Aggregates the metrics of every worker, without stopping them.
+     *
+     * Counters are read one by one while workers keep updating them, so the snapshot is
+     * not atomic as a whole, but each counter is exact and monotonic. Time spent by a task
+     * helping other tasks while it waits counts towards both its own run time and theirs.
+     */
+    MetricsSnapshot Snapshot() const;
+
+    /**
+     * @brief Writes a Snapshot() in InfluxDB line protocol or Prometheus text format.
+     *
+     * The file is overwritten (e.g. for node_exporter's textfile collector); throws
+     * std::runtime_error if it can not be opened. The second overload hands the text
+     * to a callback instead.
+     */
+    void ExportMetrics(MetricsFormat format, const std::string& path) const;
+    void ExportMetrics(MetricsFormat format, const std::function<void(const std::string&)>& sink) const;
+
+    // Turns execution tracing on or off. Does nothing unless built with THREADPOOL_TRACING.
+    void SetTracing(bool enabled) noexcept;
+
+    /**
+     * @brief Writes the events recorded so far (see ThreadPoolOptions::traceCapacity) as Chrome
+     * trace-event JSON, to open in ui.perfetto.dev or chrome://tracing.
+     *
+     * Every thread gets a track: task runs (named after TaskOptions::name) and parked periods
+     * are slices, enqueues and dequeues instants, with an arrow from each enqueue to the start
+     * of the task. Throws std::runtime_error if the file can not be opened, std::logic_error
+     * if built without THREADPOOL_TRACING.
+     */
+    void DumpTrace(const std::string& path) const;
+
+    /**
+     * @brief Allocation counters for the task path.
+     *
+     * heapAllocations includes callables that did not fit into a Task's inline storage
+     * (process-wide). Once the pool is warmed up, it should stay constant no matter
+     * how many tasks are submitted.
+     */
+    AllocationStats GetAllocationStats() const {
+        AllocationStats stats = slab_->Stats();
+        stats.heapAllocations += TaskFunction::HeapAllocations();
+        return stats;
+    }
+
+    /**
+     * @brief Submits a callable with its arguments and returns a future to its result.
+     *
+     * The callable and the arguments are moved (or copied, for lvalues) into the task, which
+     * also holds the result, so no separate promise/shared state is allocated. Exceptions thrown
+     * by the callable are rethrown by TaskFuture::get().
+     *
+     * If the pool is at capacity (admission control), waits until there is room.
+     *
+     * @return A TaskFuture for the value returned by the callable.
+     */
+    template<typename Function, typename... Args>
+        requires (!std::is_same_v<std::decay_t<Function>, TaskOptions>)
+    auto Submit(Function&& func, Args&&... args){
+        return Submit(TaskOptions{}, std::forward<Function>(func), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Same as Submit(func, args...), with per-task options such as the priority class
+     * or the NUMA node the task's data lives on.
+     */
+    template<typename Function, typename... Args>
+    auto Submit(const TaskOptions& options, Function&& func, Args&&... args){
+        auto state = NewTaskState(options, std::forward<Function>(func), std::forward<Args>(args)...);
+        AddTask(state);
+        return TaskFuture<SubmitResult<Function, Args...>>(std::move(state));
+    }
+
+    /**
+     * @brief Same as Submit(), but gives up right away if the pool is at capacity (see
+     * ThreadPoolOptions::maxPendingTasks). Rejections are counted in Snapshot().
+     *
+     * @return The TaskFuture, or an empty optional if the task was rejected.
+     */
+    template<typename Function, typename... Args>
+        requires (!std::is_same_v<std::decay_t<Function>, TaskOptions>)
+    auto TrySubmit(Function&& func, Args&&... args){
+        return TrySubmit(TaskOptions{}, std::forward<Function>(func), std::forward<Args>(args)...);
+    }
+
+    template<typename Function, typename... Args>
+    auto TrySubmit(const TaskOptions& options, Function&& func, Args&&... args){
+        return SubmitUntil(TimePoint::min(), options, std::forward<Function>(func), std::forward<Args>(args)...);
+    }
+
+    // Same as TrySubmit(), waiting up to `timeout` for room before giving up.
+    template<typename Rep, typename Period, typename Function, typename... Args>
+        requires (!std::is_same_v<std::decay_t<Function>, TaskOptions>)
+    auto TrySubmitFor(std::chrono::duration<Rep, Period> timeout, Function&& func, Args&&... args){
+        return TrySubmitFor(timeout, TaskOptions{}, std::forward<Function>(func), std::forward<Args>(args)...);
+    }
+
+    template<typename Rep, typename Period, typename Function, typename... Args>
+    auto TrySubmitFor(std::chrono::duration<Rep, Period> timeout, const TaskOptions& options, Function&& func, Args&&... args){
+        return SubmitUntil(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout),
+                           options, std::forward<Function>(func), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Runs `func` as a task of the pool once `delay` is over.
+     *
+     * Timers live in a hierarchical timer wheel (O(1) to set and to cancel, see
+     * ThreadPoolOptions::timerTick for its resolution) driven by a single timer thread, which
+     * hands due timers straight to the queues. Pending timers do not count for WaitIdle(), and
+     * are dropped by a shutdown.
+     *
+     * @return A handle to cancel the timer.
+     */
+    template<typename Rep, typename Period, typename Function>
+    TimerHandle ScheduleAfter(std::chrono::duration<Rep, Period> delay, Function&& func){
+        return ScheduleAfter(delay, TaskOptions{}, std::forward<Function>(func));
+    }
+
+    // Same as ScheduleAfter(delay, func), the task with the given options.
+    template<typename Rep, typename Period, typename Function>
+    TimerHandle ScheduleAfter(std::chrono::duration<Rep, Period> delay, const TaskOptions& options, Function&& func){
+        return ScheduleAt(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(delay),
+                          options, std::forward<Function>(func));
+    }
+
+    // Runs `func` as a task of the pool at the given time (right away if it is past).
+    template<typename Function>
+    TimerHandle ScheduleAt(std::chrono::steady_clock::time_point time, Function&& func){
+        return ScheduleAt(time, TaskOptions{}, std::forward<Function>(func));
+    }
+
+    template<typename Function>
+    TimerHandle ScheduleAt(std::chrono::steady_clock::time_point time, const TaskOptions& options, Function&& func){
+        return AddTimer(time, 0, NewTimer(options, std::forward<Function>(func)));
+    }
+
+    /**
+     * @brief Runs `func` as a task of the pool every `period`, the first time once `period` is over,
+     * until the timer is cancelled (or one of its runs is, see TaskOptions::stopToken).
+     *
+     * Runs never overlap: the next one is due once the current one is over, at the next
+     * multiple of the period (those missed meanwhile are skipped).
+     */
+    template<typename Rep, typename Period, typename Function>
+    TimerHandle ScheduleEvery(std::chrono::duration<Rep, Period> period, Function&& func){
+        return ScheduleEvery(period, TaskOptions{}, std::forward<Function>(func));
+    }
+
+    template<typename Rep, typename Period, typename Function>
+    TimerHandle ScheduleEvery(std::chrono::duration<Rep, Period> period, const TaskOptions& options, Function&& func){
+        auto interval = std::chrono::ceil<std::chrono::steady_clock::duration>(period);
+        auto ticks = static_cast<uint64_t>(std::max<int64_t>(1, (interval + timerTick_ - std::chrono::nanoseconds(1)) / timerTick_));
+        return AddTimer(std::chrono::steady_clock::now() + interval, ticks, NewTimer(options, std::forward<Function>(func)));
+    }
+
+    /**
+     * @brief `co_await pool.Schedule()` moves the calling coroutine onto one of the pool's workers.
+     *
+     * See pool::Task (Coroutine.h) for coroutines that can be awaited from each other.
+     */
+    ScheduleAwaiter Schedule(const TaskOptions& options = {}) noexcept { return ScheduleAwaiter{this, options}; }
+
+    /**
+     * @brief Creates one task per callable in the range and submits them all at once.
+     *
+     * Tasks are built outside of any lock and then spliced into the queue in a single
+     * critical section, followed by a single wake-up sweep: fanning out N tasks costs one
+     * lock round-trip instead of N.
+     *
+     * @return A TaskBatch handle to wait for the whole group.
+     */
+    template<typename Range>
+    TaskBatch CreateTasks(Range&& functions){
+        TaskBatch batch;
+        batch.state_ = std::allocate_shared<TaskBatch::State>(PooledAllocator<TaskBatch::State>(slab_));
+        if constexpr(std::ranges::sized_range<Range>)
+            batch.tasks_.reserve(std::ranges::size(functions));
+
+        for(auto&& func : functions){
+            std::shared_ptr<Task> task = NewTask();
+            if constexpr(std::is_lvalue_reference_v<Range>)
+                task->Bind(TaskBatch::Wrap(batch.state_, func));
+            else
+                task->Bind(TaskBatch::Wrap(batch.state_, std::move(func)));
+            task->OnCancel(&TaskBatch::Cancelled, batch.state_.get());
+            batch.tasks_.emplace_back(std::move(task));
+        }
+
+        batch.state_->remaining.store(static_cast<int64_t>(batch.tasks_.size()), std::memory_order_relaxed);
+        AddTasks(batch.tasks_);
+        return batch;
+    }
+
+    /**
+     * @brief Submits `count` tasks at once, the i-th one calling func(i).
+     *
+     * Same single-lock fan-out as CreateTasks(); `func` is copied into every task.
+     *
+     * @return A TaskBatch handle to wait for the whole group.
+     */
+    template<typename Function>
+    TaskBatch SubmitBatch(std::size_t count, const Function& func){
+        return SubmitBatch(TaskOptions{}, count, func);
+    }
+
+    // Same as SubmitBatch(count, func), every task of the batch with the given options.
+    template<typename Function>
+    TaskBatch SubmitBatch(const TaskOptions& options, std::size_t count, const Function& func){
+        TaskBatch batch;
+        batch.state_ = std::allocate_shared<TaskBatch::State>(PooledAllocator<TaskBatch::State>(slab_));
+        batch.tasks_.reserve(count);
+
+        for(std::size_t i = 0; i < count; i++){
+            std::shared_ptr<Task> task = NewTask();
+            task->Bind(TaskBatch::Wrap(batch.state_, [func, i](){ func(i); }));
+            task->SetOptions(options);
+            task->OnCancel(&TaskBatch::Cancelled, batch.state_.get());
+            batch.tasks_.emplace_back(std::move(task));
+        }
+
+        batch.state_->remaining.store(static_cast<int64_t>(count), std::memory_order_relaxed);
+        AddTasks(batch.tasks_);
+        return batch;
+    }
 
     /**
      * @brief Creates a new Task object with the specified function, callback and argument tuple.
@@ -124,13 +1130,16 @@ public:
      * The function, callback, and arguments are stored in the Task, which is then added to the task queue.
      *
      * This allows for flexibility in the callable's signature and the usage of arguments.
+     * Everything is forwarded into the task: pass rvalues (std::move, temporaries, a tuple
+     * built with std::make_tuple) to move move-only or large objects in without copies.
      *
      * @return A shared pointer to the created Task.
      */
-    template<typename Function, typename Callback, typename... Types>
-    std::shared_ptr<Task> CreateTask(const Function& func, const Callback& callback, const std::tuple<Types...>& argsTuple){
-        std::shared_ptr<Task> task = std::make_shared<Task>();
-        (*task)(func, callback, argsTuple);
+    template<typename Function, typename Callback, typename Tuple>
+        requires ArgumentsTuple<Tuple>
+    std::shared_ptr<Task> CreateTask(Function&& func, Callback&& callback, Tuple&& argsTuple){
+        std::shared_ptr<Task> task = NewTask();
+        (*task)(std::forward<Function>(func), std::forward<Callback>(callback), std::forward<Tuple>(argsTuple));
         AddTask(task);
         return task;
     }
@@ -146,9 +1155,10 @@ public:
      * @return A shared pointer to the created Task.
      */
     template<typename Function, typename Callback>
-    std::shared_ptr<Task> CreateTask(const Function& func, const Callback& callback){
-        std::shared_ptr<Task> task = std::make_shared<Task>();
-        (*task)(func, callback);
+        requires (!ArgumentsTuple<Callback>)
+    std::shared_ptr<Task> CreateTask(Function&& func, Callback&& callback){
+        std::shared_ptr<Task> task = NewTask();
+        (*task)(std::forward<Function>(func), std::forward<Callback>(callback));
         AddTask(task);
         return task;
     }
@@ -163,10 +1173,11 @@ public:
      *
      * @return A shared pointer to the created Task.
      */
-    template<typename Function, typename... Types>
-    std::shared_ptr<Task> CreateTask(const Function& func, const std::tuple<Types...>& argsTuple){
-        std::shared_ptr<Task> task = std::make_shared<Task>();
-        (*task)(func, argsTuple);
+    template<typename Function, typename Tuple>
+        requires ArgumentsTuple<Tuple>
+    std::shared_ptr<Task> CreateTask(Function&& func, Tuple&& argsTuple){
+        std::shared_ptr<Task> task = NewTask();
+        (*task)(std::forward<Function>(func), std::forward<Tuple>(argsTuple));
         AddTask(task);
         return task;
     }
@@ -182,12 +1193,81 @@ public:
      * @return A shared pointer to the created Task.
      */
     template<typename Function>
-    std::shared_ptr<Task> CreateTask(const Function& func){
-        std::shared_ptr<Task> task = std::make_shared<Task>();
-        (*task)(func);
+    std::shared_ptr<Task> CreateTask(Function&& func){
+        std::shared_ptr<Task> task = NewTask();
+        (*task)(std::forward<Function>(func));
         AddTask(task);
         return task;
     }
+
+    /**
+     * Parallel algorithms.
+     *
+     * All of them split the range into chunks which the calling thread and one helper
+     * task per worker consume dynamically, so a loop enqueues O(workers) tasks rather
+     * than O(iterations). The calling thread takes part in the work and returns once the
+     * whole range is done; the first exception thrown by a user callable is rethrown.
+     * A grain of 0 lets the pool choose the chunk size.
+     */
+
+    // Calls body(i) for every i in [begin, end).
+    template<typename Begin, typename End, typename Body>
+    void ParallelFor(Begin begin, End end, const Body& body, std::size_t grain = 0);
+
+    /**
+     * Returns reduce(...reduce(identity, map(begin))..., map(end - 1)). Chunks are combined in
+     * index order, so `reduce` only needs to be associative.
+     */
+    template<typename Begin, typename End, typename T, typename Map, typename Reduce>
+    T ParallelReduce(Begin begin, End end, T identity, const Map& map, const Reduce& reduce, std::size_t grain = 0);
+
+    // Writes op(*it) into the output range for every element of [first, last). Both ranges are random access.
+    template<typename RandomIt, typename RandomOutputIt, typename UnaryOp>
+    RandomOutputIt ParallelTransform(RandomIt first, RandomIt last, RandomOutputIt output, const UnaryOp& op, std::size_t grain = 0);
+
+    // Sorts [first, last) (random access): blocks are sorted in parallel and then merged pairwise in parallel.
+    template<typename RandomIt, typename Compare = std::less<>>
+    void ParallelSort(RandomIt first, RandomIt last, Compare comp = Compare());
+
+    // Inclusive scan of [first, last) with an associative op, written into the output range. Both ranges are random access.
+    template<typename RandomIt, typename RandomOutputIt, typename BinaryOp = std::plus<>>
+    RandomOutputIt ParallelScan(RandomIt first, RandomIt last, RandomOutputIt output, BinaryOp op = BinaryOp());
+};
+
+/**
+ * @brief Declares that the calling task is about to block (file I/O, a lock, a blocking
+ * call into another system) until it goes out of scope.
+ *
+ * Meanwhile the pool has a spare worker stand in for the blocked one, so that CPU-bound
+ * tasks do not queue behind it while cores sit idle; the spare retires once the region is
+ * over. Regions may nest. Outside of a pool's worker, it does nothing.
+ *
+ *     std::string ReadConfig(const std::string& path){
+ *         ScopedBlocking blocking;
+ *         return ReadFile(path);
+ *     }
+ */
+class ScopedBlocking {
+
+public:
+    ScopedBlocking() noexcept : pool_(ThreadPool::currentPool_), workerId_(ThreadPool::currentWorker_) {
+        if(pool_)
+            pool_->BeginBlocking(workerId_);
+    }
+
+    ~ScopedBlocking(){
+        if(pool_)
+            pool_->EndBlocking(workerId_);
+    }
+
+    ScopedBlocking(const ScopedBlocking&) = delete;
+    ScopedBlocking& operator=(const ScopedBlocking&) = delete;
+
+private:
+    ThreadPool* pool_;
+    int workerId_;
 };
 
+#include "ParallelAlgorithms.h"
+
 #endif //THREADPOOLLIB_THREADPOOL_H
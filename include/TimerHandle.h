@@ -0,0 +1,112 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TIMERHANDLE_H
+#define THREADPOOLLIB_TIMERHANDLE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "TaskFunction.h"
+#include "TaskOptions.h"
+#include "TimerWheel.h"
+
+/**
+ * @brief The timers of a pool: its wheel and what guards it, shared with the handles of the
+ * timers, which may outlive the pool.
+ */
+struct TimerQueue {
+    std::mutex mutex;
+    std::condition_variable cv;     // The timer thread sleeps on it until the wheel's next event.
+    TimerWheel wheel;
+    uint64_t wakeTick = 0;          // Tick the timer thread sleeps until (TimerWheel::NEVER: no event), 0 while awake.
+    bool stopped = false;
+};
+
+/**
+ * @brief Handle to a timer set with ThreadPool::ScheduleAfter(), ScheduleAt() or ScheduleEvery().
+ *
+ * Dropping the handle does not cancel the timer.
+ */
+class TimerHandle {
+
+public:
+    TimerHandle() = default;
+
+    /**
+     * @brief Stops the timer, in O(1).
+     *
+     * A run already handed to the workers still happens, but is the last one.
+     *
+     * @return Whether the timer was still active, i.e. whether this call kept it from firing
+     * (false for a one-shot timer that has already fired).
+     */
+    bool Cancel(){
+        if(!state_)
+            return false;
+        std::shared_ptr<State> self;
+        std::lock_guard<std::mutex> lock(state_->queue->mutex);
+        bool active = state_->active;
+        state_->active = false;
+        if(state_->IsLinked()){
+            state_->queue->wheel.Remove(state_.get());
+            self = std::move(state_->self);
+        }
+        return active;
+    }
+
+    // Whether the timer may still fire: not cancelled and, for a one-shot timer, not fired yet.
+    bool IsActive() const {
+        if(!state_)
+            return false;
+        std::lock_guard<std::mutex> lock(state_->queue->mutex);
+        return state_->active;
+    }
+
+private:
+    friend class ThreadPool;
+
+    struct State : TimerWheel::Entry {
+        std::shared_ptr<TimerQueue> queue;
+        TaskFunction function;
+        TaskOptions options;
+        uint64_t period = 0;            // In ticks, 0 for a one-shot timer.
+
+        // Guarded by queue->mutex.
+        bool active = true;
+        std::shared_ptr<State> self;    // Held while linked into the wheel.
+    };
+
+    // Cancel hook of the tasks a timer fires (see Task::OnCancel()): a periodic timer stops there.
+    static void Cancelled(void* state) noexcept {
+        auto* timer = static_cast<State*>(state);
+        std::lock_guard<std::mutex> lock(timer->queue->mutex);
+        timer->active = false;
+    }
+
+    explicit TimerHandle(std::shared_ptr<State> state) noexcept : state_(std::move(state)) {}
+
+    std::shared_ptr<State> state_;
+};
+
+#endif //THREADPOOLLIB_TIMERHANDLE_H
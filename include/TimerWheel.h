@@ -0,0 +1,105 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TIMERWHEEL_H
+#define THREADPOOLLIB_TIMERWHEEL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Hierarchical timing wheel over intrusive entries. Not thread-safe.
+ *
+ * Time is counted in ticks. Level L has SLOTS slots of SLOTS^L ticks each: an entry goes
+ * to the lowest level whose span still covers its expiry, and is moved one level down
+ * (cascaded) when the time reaches its slot. Entries further away than the whole wheel
+ * wait in an overflow list, looked at once per turn of the top level.
+ *
+ * Slots are circular lists with a sentinel head, so inserting and removing are O(1) and
+ * need no allocation. A bitmap per level tells which slots are in use, so that the next
+ * tick with anything to do is found without walking the slots.
+ */
+class TimerWheel {
+
+public:
+    static constexpr unsigned LEVEL_BITS = 6;
+    static constexpr std::size_t SLOTS = std::size_t(1) << LEVEL_BITS;
+    static constexpr std::size_t LEVELS = 4;
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    // To be embedded in whatever the wheel keeps track of.
+    struct Entry {
+        Entry* prev = nullptr;
+        Entry* next = nullptr;
+        uint64_t expiry = 0;        // Tick it expires at, kept once unlinked.
+        std::size_t slot = 0;
+
+        bool IsLinked() const noexcept { return prev != nullptr; }
+    };
+
+    explicit TimerWheel(uint64_t now = 0);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    uint64_t Now() const noexcept { return now_; }
+    std::size_t Size() const noexcept { return size_; }
+    bool Empty() const noexcept { return size_ == 0; }
+
+    // Links an unlinked entry expiring at the given tick (the next one if that is not ahead of Now()).
+    void Insert(Entry* entry, uint64_t expiry) noexcept;
+
+    // Unlinks a linked entry.
+    void Remove(Entry* entry) noexcept;
+
+    // First tick after Now() at which Advance() has something to do, NEVER if the wheel is empty.
+    uint64_t NextEvent() const noexcept;
+
+    /**
+     * @brief Moves the time forward to `tick`, unlinking every entry that expires meanwhile
+     * into `expired`, by expiry. Empty stretches are skipped, not walked tick by tick.
+     */
+    void Advance(uint64_t tick, std::vector<Entry*>& expired);
+
+    // Unlinks every entry into `entries`.
+    void Clear(std::vector<Entry*>& entries);
+
+private:
+    static constexpr std::size_t OVERFLOW_SLOT = LEVELS * SLOTS;
+    static constexpr uint64_t WHEEL_SPAN = uint64_t(1) << (LEVEL_BITS * LEVELS);
+
+    // Slot an entry expiring at `expiry` belongs to right now.
+    std::size_t SlotFor(uint64_t expiry) const noexcept;
+
+    void Link(Entry* entry, std::size_t slot) noexcept;
+    void Unlink(Entry* entry) noexcept;
+
+    // Re-inserts every entry of a slot, now that the time has reached it.
+    void Cascade(std::size_t slot) noexcept;
+
+    std::array<Entry, LEVELS * SLOTS + 1> heads_;
+    std::array<uint64_t, LEVELS> occupied_{};
+    uint64_t now_;
+    std::size_t size_ = 0;
+};
+
+#endif //THREADPOOLLIB_TIMERWHEEL_H
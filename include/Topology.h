@@ -0,0 +1,86 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TOPOLOGY_H
+#define THREADPOOLLIB_TOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * How workers are pinned to CPUs.
+ *
+ * AFFINITY_NONE: workers float, the OS scheduler decides (previous behaviour).
+ * AFFINITY_COMPACT: workers fill one NUMA node (core by core, SMT siblings together) before
+ * moving on to the next one. Best when workers share data.
+ * AFFINITY_SCATTER: workers are spread round-robin over the nodes, and over distinct cores
+ * within a node before SMT siblings. Best for memory bandwidth.
+ * AFFINITY_EXPLICIT: worker i is pinned to ThreadPoolOptions::cpus[i % cpus.size()].
+ */
+enum AffinityPolicy {
+    AFFINITY_NONE = 0,
+    AFFINITY_COMPACT = 1,
+    AFFINITY_SCATTER = 2,
+    AFFINITY_EXPLICIT = 3
+};
+
+/**
+ * @brief CPU and NUMA layout of the machine, as read from /sys/devices/system/{cpu,node}.
+ *
+ * Where that information is not available (non-Linux, containers hiding /sys...) every
+ * CPU reported by std::thread::hardware_concurrency() is taken as part of node 0. Only the
+ * CPUs the process may run on (its sched_getaffinity() mask, e.g. under taskset or a
+ * cpuset) are listed.
+ */
+class Topology {
+
+public:
+    struct Cpu {
+        int id;
+        int core;       // Core id within its package; SMT siblings share it.
+        int package;
+        int node;
+        int l3;         // Id of the last level cache it shares, -1 if unknown.
+    };
+
+    static Topology Detect();
+
+    const std::vector<Cpu>& GetCpus() const noexcept { return cpus_; }
+    std::size_t GetNodeCount() const noexcept { return nodeCount_; }
+
+    // The entry for the given CPU id, nullptr if it is not online.
+    const Cpu* Find(int cpu) const noexcept;
+
+    // CPU ids in the order workers are placed on them, for the given policy.
+    std::vector<int> PlacementOrder(AffinityPolicy policy, const std::vector<int>& explicitCpus) const;
+
+    // Pins the calling thread to a CPU. Returns false if it could not (or is not supported, or the id is out of range).
+    static bool PinCurrentThread(int cpu) noexcept;
+
+    // Parses a kernel CPU list such as "0-3,8,10-11".
+    static std::vector<int> ParseCpuList(const std::string& list);
+
+private:
+    std::vector<Cpu> cpus_;
+    std::size_t nodeCount_ = 1;
+};
+
+#endif //THREADPOOLLIB_TOPOLOGY_H
@@ -0,0 +1,139 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_TRACER_H
+#define THREADPOOLLIB_TRACER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/**
+ * Tracing is compiled out unless THREADPOOL_TRACING is defined to 1 (CMake option
+ * THREADPOOL_TRACING=ON): the pool then neither holds a Tracer nor records anything.
+ * The default matches the CMake one; code built with another value than the library
+ * fails to link (see ThreadPool::BuildFlags).
+ */
+#ifndef THREADPOOL_TRACING
+#define THREADPOOL_TRACING 0
+#endif
+
+enum TraceEventType {
+    TRACE_ENQUEUE = 0,      // Task added into a queue, by the thread adding it.
+    TRACE_DEQUEUE = 1,      // Task taken out of a queue by a worker.
+    TRACE_START = 2,
+    TRACE_END = 3,
+    TRACE_PARK = 4,         // Worker going to sleep on the condition variable...
+    TRACE_UNPARK = 5        // ...and waking up.
+};
+
+/**
+ * @brief Flight recorder of execution events, written as Chrome trace-event JSON (which
+ * chrome://tracing and ui.perfetto.dev open).
+ *
+ * Every thread records into its own ring buffer, single-writer, so recording an event is a
+ * steady_clock read and a few relaxed stores: no lock, no locked instruction. Once a buffer
+ * is full the oldest events are overwritten. Buffers can be read while being written: the
+ * reader drops whatever the writer may have overwritten meanwhile (seqlock-like).
+ */
+class Tracer {
+
+public:
+    // `capacity` events per thread, rounded up to a power of two.
+    explicit Tracer(std::size_t capacity);
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /**
+     * @brief Records an event in the calling thread's buffer. `name` has to outlive the
+     * tracer (a string literal); `id` ties together the events of the same task. The track of
+     * the thread is named after `workerId` (-1 if the thread is not a worker).
+     */
+    void Record(TraceEventType type, const char* name, uint64_t id, int workerId){
+        Buffer* buffer = LocalBuffer(workerId);
+        uint64_t index = buffer->claimed.load(std::memory_order_relaxed);
+        buffer->claimed.store(index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        Event& event = buffer->events[index & mask_];
+        event.timestamp.store(Now(), std::memory_order_relaxed);
+        event.id.store(id, std::memory_order_relaxed);
+        event.name.store(name, std::memory_order_relaxed);
+        event.type.store(type, std::memory_order_relaxed);
+        buffer->written.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Writes every event still in the buffers as a Chrome trace-event JSON object.
+     *
+     * Task runs and parked periods are slices on their thread's track, enqueues and dequeues
+     * instants; a flow arrow goes from each enqueue to the start of the task.
+     */
+    void Write(std::ostream& out) const;
+
+private:
+    struct Event {
+        std::atomic<uint64_t> timestamp{0};
+        std::atomic<uint64_t> id{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint32_t> type{0};
+    };
+
+    struct Buffer {
+        std::thread::id owner;
+        int worker;
+        std::unique_ptr<Event[]> events;
+
+        // Events claimed (about to be written) and written by the owner, over the buffer's life.
+        std::atomic<uint64_t> claimed{0};
+        std::atomic<uint64_t> written{0};
+    };
+
+    struct BufferCache {
+        uint64_t tracerId;
+        Buffer* buffer;
+    };
+
+    static uint64_t Now() noexcept;
+
+    Buffer* LocalBuffer(int workerId){
+        if(cache_.tracerId == id_)
+            return cache_.buffer;
+        return AddBuffer(workerId);
+    }
+
+    // Slow path of LocalBuffer(): the thread's first event, or it alternates between tracers.
+    Buffer* AddBuffer(int workerId);
+
+    uint64_t id_;
+    std::size_t mask_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+
+    static thread_local BufferCache cache_;
+};
+
+#endif //THREADPOOLLIB_TRACER_H
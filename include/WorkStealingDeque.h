@@ -0,0 +1,186 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_WORKSTEALINGDEQUE_H
+#define THREADPOOLLIB_WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Lock-free Chase-Lev work-stealing deque.
+ *
+ * The owner thread pushes and pops at the bottom (LIFO, cache friendly), while any
+ * other thread may steal from the top (FIFO). Only the single-element race between
+ * the owner and thieves is resolved with a CAS on `top_`, so the common push/pop path
+ * is wait-free for the owner.
+ *
+ * Implementation follows "Correct and Efficient Work-Stealing for Weak Memory Models"
+ * (Lê, Pop, Cohen, Zappa Nardelli - PPoPP'13).
+ *
+ * T must be trivially copyable and default constructible; a default constructed T
+ * (nullptr for pointers) is returned when there is nothing to pop or steal.
+ */
+template<typename T>
+class WorkStealingDeque {
+
+private:
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    /**
+     * Circular buffer with power-of-two capacity. Slots are atomics so that a thief
+     * reading a slot concurrently with the owner overwriting it is well defined.
+     */
+    struct Array {
+        explicit Array(int64_t capacity)
+            : capacity_(capacity), mask_(capacity - 1), buffer_(new std::atomic<T>[capacity]) {}
+
+        int64_t Capacity() const noexcept { return capacity_; }
+        T Get(int64_t i) const noexcept { return buffer_[i & mask_].load(std::memory_order_relaxed); }
+        void Put(int64_t i, T item) noexcept { buffer_[i & mask_].store(item, std::memory_order_relaxed); }
+
+        Array* Grow(int64_t bottom, int64_t top) const {
+            auto* array = new Array(capacity_ * 2);
+            for(int64_t i = top; i < bottom; i++)
+                array->Put(i, Get(i));
+            return array;
+        }
+
+        int64_t capacity_;
+        int64_t mask_;
+        std::unique_ptr<std::atomic<T>[]> buffer_;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<Array*> array_;
+
+    /**
+     * Arrays replaced by a Grow() may still be read by a thief that loaded the old
+     * pointer, so they are kept alive until the deque itself is destroyed.
+     */
+    std::vector<std::unique_ptr<Array>> retired_;
+
+public:
+    explicit WorkStealingDeque(int64_t capacity = 256) : array_(new Array(capacity)) {}
+
+    ~WorkStealingDeque() { delete array_.load(std::memory_order_relaxed); }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    /**
+     * @brief Pushes an item at the bottom. Owner thread only.
+     */
+    void Push(T item){
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+
+        if(bottom - top > array->Capacity() - 1){
+            retired_.emplace_back(array);
+            array = array->Grow(bottom, top);
+            array_.store(array, std::memory_order_release);
+        }
+
+        array->Put(bottom, item);
+        bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Pops the most recently pushed item. Owner thread only.
+     */
+    T Pop(){
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+
+        T item{};
+        if(top <= bottom){
+            item = array->Get(bottom);
+            if(top == bottom){
+                // Last element: race against thieves for it.
+                if(!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    item = T{};
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+            }
+        } else
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+
+        return item;
+    }
+
+    /**
+     * @brief Steals the oldest item. May be called from any thread.
+     *
+     * Returns T{} when the deque is empty or when the steal lost a race, callers
+     * are expected to simply move on to the next victim.
+     */
+    T Steal(){
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+        if(top < bottom){
+            Array* array = array_.load(std::memory_order_acquire);
+            T item = array->Get(top);
+            if(!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return T{};
+            return item;
+        }
+        return T{};
+    }
+
+    /**
+     * @brief Moves the items to a new array allocated by the calling thread. Owner thread only.
+     *
+     * Meant to be called once the owner is pinned: the new array is first touched there, so
+     * on NUMA machines it lands on the owner's node rather than on the one of the thread that
+     * constructed the deque. The old array is retired like after a Grow().
+     */
+    void Localize(){
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Array* old = array_.load(std::memory_order_relaxed);
+
+        auto* array = new Array(old->Capacity());
+        for(int64_t i = top; i < bottom; i++)
+            array->Put(i, old->Get(i));
+        retired_.emplace_back(old);
+        array_.store(array, std::memory_order_release);
+    }
+
+    /**
+     * Approximate when called concurrently, exact from the owner when no thieves run.
+     */
+    bool Empty() const noexcept { return Size() <= 0; }
+
+    int64_t Size() const noexcept {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        return bottom - top;
+    }
+};
+
+#endif //THREADPOOLLIB_WORKSTEALINGDEQUE_H
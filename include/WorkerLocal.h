@@ -0,0 +1,182 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#ifndef THREADPOOLLIB_WORKERLOCAL_H
+#define THREADPOOLLIB_WORKERLOCAL_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/**
+ * @brief One instance of T per worker of a pool, each on its own cache lines, for tasks to
+ * accumulate into without sharing anything; Combine() reduces them once the work is over.
+ *
+ * Local() is a thread-local read plus an index into a table that only grows (the first use
+ * by a worker beyond it allocates, every instance starting as a copy of `initial`). Threads
+ * that are not workers of the pool, e.g. the one calling ParallelFor(), get instances of
+ * their own, looked up under a lock.
+ *
+ *     WorkerLocal<Histogram> histograms(pool);
+ *     pool.ParallelFor(0, samples.size(), [&](std::size_t i){ histograms.Local().Add(samples[i]); });
+ *     Histogram total = histograms.Combine([](Histogram a, const Histogram& b){ return a.Merge(b); });
+ */
+template<typename T>
+class WorkerLocal {
+
+public:
+    explicit WorkerLocal(ThreadPool& pool, const T& initial = T()) : pool_(&pool), initial_(initial) {}
+
+    WorkerLocal(const WorkerLocal&) = delete;
+    WorkerLocal& operator=(const WorkerLocal&) = delete;
+
+    ~WorkerLocal(){
+        for(std::size_t segment = 0; segment < SEGMENTS; segment++){
+            if(Slot* slots = segments_[segment].load(std::memory_order_relaxed))
+                DestroySegment(slots, SegmentSize(segment));
+        }
+    }
+
+    // Instance of the calling thread.
+    T& Local(){
+        if(ThreadPool::CurrentPool() != pool_)
+            return Outside().value;
+
+        auto index = static_cast<std::size_t>(ThreadPool::CurrentWorker());
+        std::size_t segment = std::bit_width(index / FIRST_SEGMENT + 1) - 1;
+        Slot* slots = segments_[segment].load(std::memory_order_acquire);
+        if(!slots)
+            slots = Grow(segment);
+        Slot& slot = slots[index - SegmentStart(segment)];
+        if(!slot.used)
+            slot.used = true;
+        return slot.value;
+    }
+
+    /**
+     * @brief Calls func(instance) on every instance used so far. Not synchronized with
+     * Local(): to be called once the tasks using them are over.
+     */
+    template<typename Function>
+    void ForEach(Function&& func){
+        for(std::size_t segment = 0; segment < SEGMENTS; segment++){
+            Slot* slots = segments_[segment].load(std::memory_order_acquire);
+            for(std::size_t i = 0; slots && i < SegmentSize(segment); i++){
+                if(slots[i].used)
+                    func(slots[i].value);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto& [threadId, slot] : outside_)
+            func(slot->value);
+    }
+
+    /**
+     * @brief reduce(...reduce(first, second)..., last) over the instances used so far, in no
+     * particular order; `initial` if none was. Same restriction as ForEach().
+     */
+    template<typename Reduce>
+    T Combine(Reduce&& reduce){
+        std::unique_ptr<T> result;
+        ForEach([&](T& value){
+            if(result)
+                *result = reduce(std::move(*result), value);
+            else
+                result = std::make_unique<T>(value);
+        });
+        return result ? std::move(*result) : initial_;
+    }
+
+private:
+    struct alignas(64) alignas(T) Slot {
+        explicit Slot(const T& value) : value(value) {}
+
+        T value;
+        bool used = false;
+    };
+
+    /**
+     * Segment k holds FIRST_SEGMENT << k slots, starting at index FIRST_SEGMENT * (2^k - 1):
+     * the table grows without ever moving an instance.
+     */
+    static constexpr std::size_t FIRST_SEGMENT = 8;
+    static constexpr std::size_t SEGMENTS = 32;
+
+    static constexpr std::size_t SegmentSize(std::size_t segment) noexcept { return FIRST_SEGMENT << segment; }
+    static constexpr std::size_t SegmentStart(std::size_t segment) noexcept {
+        return FIRST_SEGMENT * ((std::size_t(1) << segment) - 1);
+    }
+
+    Slot* Grow(std::size_t segment){
+        std::size_t size = SegmentSize(segment);
+        auto* slots = static_cast<Slot*>(::operator new(size * sizeof(Slot), std::align_val_t(alignof(Slot))));
+        std::size_t built = 0;
+        try {
+            for(; built < size; built++)
+                ::new(&slots[built]) Slot(initial_);
+        } catch(...) {
+            DestroySegment(slots, built);
+            throw;
+        }
+
+        // Two workers may race for the same segment: the loser's copy goes away.
+        Slot* expected = nullptr;
+        if(segments_[segment].compare_exchange_strong(expected, slots, std::memory_order_acq_rel))
+            return slots;
+        DestroySegment(slots, size);
+        return expected;
+    }
+
+    static void DestroySegment(Slot* slots, std::size_t size) noexcept {
+        for(std::size_t i = 0; i < size; i++)
+            slots[i].~Slot();
+        ::operator delete(slots, std::align_val_t(alignof(Slot)));
+    }
+
+    Slot& Outside(){
+        std::thread::id threadId = std::this_thread::get_id();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto& [owner, slot] : outside_){
+            if(owner == threadId)
+                return *slot;
+        }
+        outside_.emplace_back(threadId, std::make_unique<Slot>(initial_));
+        return *outside_.back().second;
+    }
+
+    ThreadPool* pool_;
+    T initial_;
+    std::array<std::atomic<Slot*>, SEGMENTS> segments_{};
+
+    // Threads that are not workers of the pool.
+    std::mutex mutex_;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<Slot>>> outside_;
+};
+
+#endif //THREADPOOLLIB_WORKERLOCAL_H
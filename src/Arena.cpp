@@ -0,0 +1,52 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <algorithm>
+#include "Arena.h"
+
+void Arena::Rewind(const Marker& mark) noexcept {
+    current_ = mark.chunk;
+    offset_ = mark.offset;
+    auto free = chunks_.begin() + static_cast<std::ptrdiff_t>(std::min(current_ + 1, chunks_.size()));
+    chunks_.erase(std::remove_if(free, chunks_.end(), [this](const Chunk& chunk){ return chunk.size > chunkSize_; }),
+                  chunks_.end());
+}
+
+std::size_t Arena::Capacity() const noexcept {
+    std::size_t capacity = 0;
+    for(const Chunk& chunk : chunks_)
+        capacity += chunk.size;
+    return capacity;
+}
+
+void* Arena::Refill(std::size_t size, std::size_t alignment) {
+    std::size_t needed = size + alignment - 1;
+    std::size_t next = current_ < chunks_.size() ? current_ + 1 : current_;
+
+    // Chunks past the current one are free (left over by a rewind): the next one is reused if it fits.
+    if(next >= chunks_.size() || chunks_[next].size < needed){
+        std::size_t chunkSize = std::max(chunkSize_, needed);
+        chunks_.insert(chunks_.begin() + static_cast<std::ptrdiff_t>(next),
+                       Chunk{std::make_unique_for_overwrite<unsigned char[]>(chunkSize), chunkSize});
+    }
+    current_ = next;
+    offset_ = 0;
+    return Allocate(size, alignment);
+}
@@ -0,0 +1,215 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "Pipeline.h"
+#include "ThreadPool.h"
+
+Pipeline::Pipeline(ThreadPool& pool, std::size_t maxTokens)
+    : maxTokens_(std::max<std::size_t>(maxTokens, 1)), state_(std::make_shared<State>()) {
+    state_->pool = &pool;
+    state_->items = std::make_unique<Item[]>(maxTokens_);
+    for(std::size_t token = 0; token < maxTokens_; token++)
+        state_->items[token].state = state_.get();
+    state_->stages.push_back(std::make_unique<Stage>(STAGE_SERIAL_OUT_OF_ORDER, maxTokens_));
+}
+
+void Pipeline::Run() {
+    State& state = *state_;
+    if(!state.source)
+        throw std::logic_error("Pipeline::Run(): no source set");
+
+    state.stopped = false;
+    state.produced = 0;
+    state.cancelled.store(false, std::memory_order_relaxed);
+    state.failed.store(false, std::memory_order_relaxed);
+    state.exception = nullptr;
+    for(std::unique_ptr<Stage>& stage : state.stages){
+        stage->busy = false;
+        stage->next = 0;
+        stage->head = 0;
+        stage->count = 0;
+    }
+
+    // Every token but the first one waits at the source, which the first one starts with.
+    Stage& source = *state.stages.front();
+    for(std::size_t token = 1; token < maxTokens_; token++)
+        Push(source, &state.items[token]);
+    source.busy = true;
+    state.liveTokens.store(static_cast<int64_t>(maxTokens_), std::memory_order_relaxed);
+
+    try {
+        Schedule(state_, &state.items[0], 0);
+    } catch(...) {
+        while(Pop(source))
+            ;
+        state.liveTokens.store(0, std::memory_order_relaxed);
+        throw;
+    }
+    ThreadPool::HelpUntilZero(state.liveTokens);
+
+    if(state.failed.load(std::memory_order_acquire))
+        std::rethrow_exception(state.exception);
+}
+
+void Pipeline::Carry(const std::shared_ptr<State>& state, Item* item, std::size_t stage, bool claimed) {
+    for(;;){
+        Stage& current = *state->stages[stage];
+        bool serial = current.mode != STAGE_PARALLEL;
+        if(serial && !claimed){
+            std::unique_lock<std::mutex> lock(current.mutex);
+            if(state->cancelled.load(std::memory_order_relaxed) || (stage == 0 && state->stopped)){
+                lock.unlock();
+                Retire(*state, item);
+                return;
+            }
+            bool inOrder = current.mode == STAGE_SERIAL_IN_ORDER;
+            if(current.busy || (inOrder && item->sequence != current.next)){
+                if(inOrder)
+                    current.waiting[item->sequence % current.waiting.size()] = item;
+                else
+                    Push(current, item);
+                return;
+            }
+            current.busy = true;
+        }
+        claimed = false;
+
+        bool carryOn = !state->cancelled.load(std::memory_order_acquire) && RunStage(*state, current, stage, item);
+        if(serial)
+            Release(state, current, stage);
+        if(!carryOn){
+            Retire(*state, item);
+            return;
+        }
+
+        // Through the last stage: the token goes back to the source for the next item.
+        if(++stage == state->stages.size()){
+            item->value.Reset();
+            stage = 0;
+        }
+    }
+}
+
+bool Pipeline::RunStage(State& state, Stage& stage, std::size_t index, Item* item) {
+    try {
+        if(index > 0){
+            stage.function(item->value);
+            return true;
+        }
+
+        FlowControl flow;
+        state.source(item->value, flow);
+        if(flow.IsStopped()){
+            std::lock_guard<std::mutex> lock(stage.mutex);
+            state.stopped = true;
+            return false;
+        }
+        item->sequence = state.produced++;
+        return true;
+    } catch(...) {
+        Fail(state, std::current_exception());
+        return false;
+    }
+}
+
+void Pipeline::Release(const std::shared_ptr<State>& state, Stage& stage, std::size_t index) {
+    Item* next = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(stage.mutex);
+        stage.busy = false;
+        if(stage.mode == STAGE_SERIAL_IN_ORDER)
+            stage.next++;
+        // Whatever waits is retired by Fail().
+        if(state->cancelled.load(std::memory_order_relaxed))
+            return;
+
+        if(stage.mode == STAGE_SERIAL_IN_ORDER)
+            next = std::exchange(stage.waiting[stage.next % stage.waiting.size()], nullptr);
+        else if(index == 0 && state->stopped){
+            // Tokens waiting for a source that has stopped retire right away (the caller's own is still live).
+            while(Item* item = Pop(stage))
+                Retire(*state, item);
+        } else
+            next = Pop(stage);
+        stage.busy = next != nullptr;
+    }
+    if(!next)
+        return;
+
+    try {
+        Schedule(state, next, index);
+    } catch(...) {
+        // Hand-offs wait for room even in a full rejecting pool: out of memory.
+        Fail(*state, std::current_exception());
+        Retire(*state, next);
+    }
+}
+
+void Pipeline::Schedule(const std::shared_ptr<State>& state, Item* item, std::size_t stage) {
+    std::shared_ptr<Task> task = state->pool->NewTask();
+    task->Bind([state, item, stage](){ Carry(state, item, stage, true); });
+    task->OnCancel(&Pipeline::Cancelled, item);
+    state->pool->HandOff(std::move(task));
+}
+
+void Pipeline::Fail(State& state, std::exception_ptr exception) noexcept {
+    if(!state.failed.exchange(true, std::memory_order_acq_rel))
+        state.exception = std::move(exception);
+    state.cancelled.store(true, std::memory_order_release);
+
+    // Items parking from now on see the flag under the same lock, and retire instead.
+    for(std::unique_ptr<Stage>& stage : state.stages){
+        std::lock_guard<std::mutex> lock(stage->mutex);
+        for(Item*& item : stage->waiting){
+            if(item)
+                Retire(state, std::exchange(item, nullptr));
+        }
+        stage->head = 0;
+        stage->count = 0;
+    }
+}
+
+void Pipeline::Cancelled(void* context) noexcept {
+    auto* item = static_cast<Item*>(context);
+    Fail(*item->state, std::make_exception_ptr(PoolShutdownError("ThreadPool is shutting down")));
+    Retire(*item->state, item);
+}
+
+void Pipeline::Retire(State& state, Item* item) noexcept {
+    item->value.Reset();
+    if(state.liveTokens.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        state.liveTokens.notify_all();
+}
+
+void Pipeline::Push(Stage& stage, Item* item) noexcept {
+    stage.waiting[(stage.head + stage.count) % stage.waiting.size()] = item;
+    stage.count++;
+}
+
+Pipeline::Item* Pipeline::Pop(Stage& stage) noexcept {
+    if(stage.count == 0)
+        return nullptr;
+    Item* item = std::exchange(stage.waiting[stage.head], nullptr);
+    stage.head = (stage.head + 1) % stage.waiting.size();
+    stage.count--;
+    return item;
+}
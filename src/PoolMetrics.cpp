@@ -0,0 +1,198 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <sstream>
+#include "PoolMetrics.h"
+
+namespace {
+    // Exclusive upper bound, in nanoseconds, of a histogram bucket.
+    uint64_t BucketBound(std::size_t bucket){
+        return bucket < 64 ? uint64_t{1} << bucket : UINT64_MAX;
+    }
+
+    struct Counter {
+        const char* name;
+        const char* help;
+        uint64_t WorkerMetricsSnapshot::* value;
+        bool isTime;
+    };
+
+    const Counter COUNTERS[] = {
+        {"tasks_executed", "Tasks executed by the worker.", &WorkerMetricsSnapshot::tasksExecuted, false},
+        {"busy", "Time spent running tasks.", &WorkerMetricsSnapshot::busyTime, true},
+        {"idle", "Time spent spinning or parked.", &WorkerMetricsSnapshot::idleTime, true},
+        {"queue_wait", "Time executed tasks spent queued.", &WorkerMetricsSnapshot::queueWaitTime, true},
+        {"steals", "Tasks stolen from other workers.", &WorkerMetricsSnapshot::steals, false},
+        {"lock_contentions", "Shared queue lock acquisitions that had to wait.", &WorkerMetricsSnapshot::lockContentions, false}
+    };
+
+    void FormatInflux(const MetricsSnapshot& snapshot, const std::string& name, std::ostringstream& out){
+        out << name << "_pool pending_tasks=" << snapshot.pendingTasks << "i,sleeping_workers="
+            << snapshot.sleepingWorkers << "i,rejected_tasks=" << snapshot.rejectedTasks << "u,cancelled_tasks="
+            << snapshot.cancelledTasks << "u,expired_tasks=" << snapshot.expiredTasks << "u,admitted_bytes="
+            << snapshot.admittedBytes << "i,blocked_workers=" << snapshot.blockedWorkers << "i,spare_workers="
+            << snapshot.spareWorkers << "i,compensations=" << snapshot.compensations << "u " << snapshot.timestamp << "\n";
+
+        WorkerMetricsSnapshot total = snapshot.Total();
+        for(std::size_t priority = 0; priority < PRIORITY_CLASSES; priority++){
+            out << name << "_priority,class=" << PriorityName(static_cast<TaskPriority>(priority))
+                << " queue_depth=" << snapshot.queueDepth[priority] << "i,tasks_executed="
+                << total.priorityTasks[priority] << "u,queue_wait_ns=" << total.priorityWaitTime[priority]
+                << "u " << snapshot.timestamp << "\n";
+        }
+
+        for(std::size_t worker = 0; worker < snapshot.workers.size(); worker++){
+            const WorkerMetricsSnapshot& metrics = snapshot.workers[worker];
+            out << name << ",worker=" << worker << " ";
+            for(const Counter& counter : COUNTERS)
+                out << counter.name << (counter.isTime ? "_ns=" : "=") << metrics.*counter.value << "u,";
+            out << "run_p50_ns=" << metrics.RunTimePercentile(0.50) << "u,run_p99_ns="
+                << metrics.RunTimePercentile(0.99) << "u " << snapshot.timestamp << "\n";
+        }
+    }
+
+    void FormatPrometheus(const MetricsSnapshot& snapshot, const std::string& name, std::ostringstream& out){
+        out << "# TYPE " << name << "_pending_tasks gauge\n" << name << "_pending_tasks " << snapshot.pendingTasks << "\n";
+        out << "# TYPE " << name << "_sleeping_workers gauge\n" << name << "_sleeping_workers " << snapshot.sleepingWorkers << "\n";
+        out << "# HELP " << name << "_rejected_tasks_total Submissions rejected by admission control or a full queue.\n"
+            << "# TYPE " << name << "_rejected_tasks_total counter\n" << name << "_rejected_tasks_total " << snapshot.rejectedTasks << "\n";
+        out << "# HELP " << name << "_cancelled_tasks_total Tasks dropped without running, stop requested or shutdown.\n"
+            << "# TYPE " << name << "_cancelled_tasks_total counter\n" << name << "_cancelled_tasks_total " << snapshot.cancelledTasks << "\n";
+        out << "# HELP " << name << "_expired_tasks_total Tasks dropped without running, deadline passed while queued.\n"
+            << "# TYPE " << name << "_expired_tasks_total counter\n" << name << "_expired_tasks_total " << snapshot.expiredTasks << "\n";
+        out << "# TYPE " << name << "_admitted_bytes gauge\n" << name << "_admitted_bytes " << snapshot.admittedBytes << "\n";
+        out << "# TYPE " << name << "_blocked_workers gauge\n" << name << "_blocked_workers " << snapshot.blockedWorkers << "\n";
+        out << "# TYPE " << name << "_spare_workers gauge\n" << name << "_spare_workers " << snapshot.spareWorkers << "\n";
+        out << "# HELP " << name << "_compensations_total Spare workers started to stand in for blocked ones.\n"
+            << "# TYPE " << name << "_compensations_total counter\n" << name << "_compensations_total " << snapshot.compensations << "\n";
+
+        WorkerMetricsSnapshot total = snapshot.Total();
+        auto priorityMetric = [&](const std::string& metric, const char* type, const auto& valueOf){
+            out << "# TYPE " << metric << " " << type << "\n";
+            for(std::size_t priority = 0; priority < PRIORITY_CLASSES; priority++)
+                out << metric << "{class=\"" << PriorityName(static_cast<TaskPriority>(priority)) << "\"} "
+                    << valueOf(priority) << "\n";
+        };
+        priorityMetric(name + "_priority_queue_depth", "gauge",
+                       [&](std::size_t priority){ return snapshot.queueDepth[priority]; });
+        priorityMetric(name + "_priority_tasks_executed_total", "counter",
+                       [&](std::size_t priority){ return total.priorityTasks[priority]; });
+        priorityMetric(name + "_priority_queue_wait_seconds_total", "counter",
+                       [&](std::size_t priority){ return static_cast<double>(total.priorityWaitTime[priority]) / 1e9; });
+
+        for(const Counter& counter : COUNTERS){
+            std::string metric = name + "_" + counter.name + (counter.isTime ? "_seconds_total" : "_total");
+            out << "# HELP " << metric << " " << counter.help << "\n# TYPE " << metric << " counter\n";
+            for(std::size_t worker = 0; worker < snapshot.workers.size(); worker++){
+                uint64_t value = snapshot.workers[worker].*counter.value;
+                out << metric << "{worker=\"" << worker << "\"} ";
+                if(counter.isTime)
+                    out << static_cast<double>(value) / 1e9 << "\n";
+                else
+                    out << value << "\n";
+            }
+        }
+
+        std::string metric = name + "_task_run_seconds";
+        out << "# HELP " << metric << " Task run time.\n# TYPE " << metric << " histogram\n";
+        for(std::size_t worker = 0; worker < snapshot.workers.size(); worker++){
+            const WorkerMetricsSnapshot& metrics = snapshot.workers[worker];
+            uint64_t cumulative = 0;
+            for(std::size_t bucket = 0; bucket + 1 < METRICS_HISTOGRAM_BUCKETS; bucket++){
+                cumulative += metrics.runTimeHistogram[bucket];
+                out << metric << "_bucket{worker=\"" << worker << "\",le=\""
+                    << static_cast<double>(BucketBound(bucket)) / 1e9 << "\"} " << cumulative << "\n";
+            }
+            cumulative += metrics.runTimeHistogram.back();
+            out << metric << "_bucket{worker=\"" << worker << "\",le=\"+Inf\"} " << cumulative << "\n";
+            out << metric << "_sum{worker=\"" << worker << "\"} " << static_cast<double>(metrics.busyTime) / 1e9 << "\n";
+            out << metric << "_count{worker=\"" << worker << "\"} " << cumulative << "\n";
+        }
+    }
+}
+
+WorkerMetricsSnapshot& WorkerMetricsSnapshot::operator+=(const WorkerMetricsSnapshot& other) noexcept {
+    tasksExecuted += other.tasksExecuted;
+    busyTime += other.busyTime;
+    idleTime += other.idleTime;
+    queueWaitTime += other.queueWaitTime;
+    steals += other.steals;
+    lockContentions += other.lockContentions;
+    for(std::size_t bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+        runTimeHistogram[bucket] += other.runTimeHistogram[bucket];
+    for(std::size_t priority = 0; priority < PRIORITY_CLASSES; priority++){
+        priorityTasks[priority] += other.priorityTasks[priority];
+        priorityWaitTime[priority] += other.priorityWaitTime[priority];
+    }
+    return *this;
+}
+
+uint64_t WorkerMetricsSnapshot::RunTimePercentile(double p) const noexcept {
+    uint64_t total = 0;
+    for(uint64_t count : runTimeHistogram)
+        total += count;
+    if(total == 0)
+        return 0;
+
+    auto target = static_cast<uint64_t>(p * static_cast<double>(total));
+    uint64_t cumulative = 0;
+    for(std::size_t bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++){
+        cumulative += runTimeHistogram[bucket];
+        if(cumulative > target)
+            return BucketBound(bucket);
+    }
+    return BucketBound(METRICS_HISTOGRAM_BUCKETS - 1);
+}
+
+WorkerMetricsSnapshot MetricsSnapshot::Total() const noexcept {
+    WorkerMetricsSnapshot total;
+    for(const WorkerMetricsSnapshot& worker : workers)
+        total += worker;
+    return total;
+}
+
+std::string MetricsSnapshot::Format(MetricsFormat format, const std::string& name) const {
+    std::ostringstream out;
+    out.precision(12);
+    if(format == METRICS_PROMETHEUS)
+        FormatPrometheus(*this, name, out);
+    else
+        FormatInflux(*this, name, out);
+    return out.str();
+}
+
+#if THREADPOOL_METRICS
+WorkerMetricsSnapshot WorkerMetrics::Load() const noexcept {
+    WorkerMetricsSnapshot snapshot;
+    snapshot.tasksExecuted = tasksExecuted.load(std::memory_order_relaxed);
+    snapshot.busyTime = busyTime.load(std::memory_order_relaxed);
+    snapshot.idleTime = idleTime.load(std::memory_order_relaxed);
+    snapshot.queueWaitTime = queueWaitTime.load(std::memory_order_relaxed);
+    snapshot.steals = steals.load(std::memory_order_relaxed);
+    snapshot.lockContentions = lockContentions.load(std::memory_order_relaxed);
+    for(std::size_t bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+        snapshot.runTimeHistogram[bucket] = runTimeHistogram[bucket].load(std::memory_order_relaxed);
+    for(std::size_t priority = 0; priority < PRIORITY_CLASSES; priority++){
+        snapshot.priorityTasks[priority] = priorityTasks[priority].load(std::memory_order_relaxed);
+        snapshot.priorityWaitTime[priority] = priorityWaitTime[priority].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+#endif
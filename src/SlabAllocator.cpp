@@ -0,0 +1,204 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <new>
+#include "SlabAllocator.h"
+
+namespace {
+    std::atomic<uint64_t> nextAllocatorId{1};
+
+    /**
+     * Allocators released while some of their blocks were still in use. They are
+     * checked again every time another allocator is released, and at thread exit.
+     */
+    std::mutex orphansMutex;
+    std::vector<SlabAllocator*> orphans;
+
+    uint32_t SizeClassFor(std::size_t blockSize){
+        uint32_t sizeClass = 0;
+        std::size_t classSize = SlabAllocator::MIN_BLOCK_SIZE;
+        while(classSize < blockSize){
+            classSize <<= 1;
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+}
+
+thread_local SlabAllocator::HeapCache SlabAllocator::cache_{0, nullptr};
+thread_local SlabAllocator::Reaper SlabAllocator::reaper_;
+
+SlabAllocator::Reaper::~Reaper() {
+    std::lock_guard<std::mutex> lock(orphansMutex);
+    ReapOrphans();
+}
+
+SlabAllocator::SlabAllocator() : id_(nextAllocatorId.fetch_add(1, std::memory_order_relaxed)) {}
+
+void* SlabAllocator::Allocate(std::size_t size) {
+    static_assert(sizeof(BlockHeader) == 16, "Blocks must keep a 16 byte alignment");
+
+    std::size_t blockSize = size + sizeof(BlockHeader);
+    if(blockSize > MAX_BLOCK_SIZE){
+        auto* header = static_cast<BlockHeader*>(::operator new(blockSize));
+        header->heap = nullptr;
+        heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+        return header + 1;
+    }
+
+    Heap* heap = LocalHeap();
+    uint32_t sizeClass = SizeClassFor(blockSize);
+
+    void* block;
+    if(FreeBlock* freeBlock = heap->freeLists[sizeClass]){
+        heap->freeLists[sizeClass] = freeBlock->next;
+        block = freeBlock;
+    } else
+        block = Refill(heap, sizeClass);
+
+    heap->allocated.fetch_add(1, std::memory_order_relaxed);
+    heap->served.fetch_add(1, std::memory_order_relaxed);
+
+    auto* header = static_cast<BlockHeader*>(block);
+    header->heap = heap;
+    header->sizeClass = sizeClass;
+    return header + 1;
+}
+
+void SlabAllocator::Deallocate(void* ptr) noexcept {
+    if(!ptr)
+        return;
+
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+    Heap* heap = header->heap;
+    if(!heap){
+        ::operator delete(header);
+        return;
+    }
+
+    uint32_t sizeClass = header->sizeClass;
+    auto* freeBlock = reinterpret_cast<FreeBlock*>(header);
+
+    /*
+     * The counters are the last thing touched: once they are updated the heap may
+     * be reclaimed by a concurrent Release().
+     */
+    if(cache_.heap == heap && cache_.allocatorId == heap->allocatorId){
+        freeBlock->next = heap->freeLists[sizeClass];
+        heap->freeLists[sizeClass] = freeBlock;
+        heap->allocated.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    FreeBlock* head = heap->remoteFree[sizeClass].load(std::memory_order_relaxed);
+    do {
+        freeBlock->next = head;
+    } while(!heap->remoteFree[sizeClass].compare_exchange_weak(head, freeBlock,
+                                                               std::memory_order_release,
+                                                               std::memory_order_relaxed));
+    heap->remoteFreed.fetch_add(1, std::memory_order_release);
+}
+
+void SlabAllocator::Release() {
+    std::lock_guard<std::mutex> lock(orphansMutex);
+    orphans.push_back(this);
+    ReapOrphans();
+}
+
+AllocationStats SlabAllocator::Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AllocationStats stats{0, heapAllocations_.load(std::memory_order_relaxed)};
+    for(const std::unique_ptr<Heap>& heap : heaps_)
+        stats.slabAllocations += heap->served.load(std::memory_order_relaxed);
+    return stats;
+}
+
+SlabAllocator::Heap* SlabAllocator::LocalHeap() {
+    if(cache_.allocatorId == id_)
+        return cache_.heap;
+
+    // Slow path: first allocation from this thread, or the thread alternates between pools.
+    std::thread::id threadId = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Heap* heap = nullptr;
+    for(const std::unique_ptr<Heap>& candidate : heaps_){
+        if(candidate->owner == threadId){
+            heap = candidate.get();
+            break;
+        }
+    }
+
+    if(!heap){
+        // Constructs this thread's reaper: the blocks it holds may be the last ones of an orphan.
+        (void)&reaper_;
+        heaps_.emplace_back(std::make_unique<Heap>());
+        heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+        heap = heaps_.back().get();
+        heap->allocator = this;
+        heap->allocatorId = id_;
+        heap->owner = threadId;
+    }
+
+    cache_ = HeapCache{id_, heap};
+    return heap;
+}
+
+void* SlabAllocator::Refill(Heap* heap, uint32_t sizeClass) {
+    std::size_t blockSize = MIN_BLOCK_SIZE << sizeClass;
+
+    // Adopt whatever other threads have given back before going to the global heap.
+    if(FreeBlock* remote = heap->remoteFree[sizeClass].exchange(nullptr, std::memory_order_acquire)){
+        heap->freeLists[sizeClass] = remote->next;
+        return remote;
+    }
+
+    std::size_t blocks = CHUNK_SIZE / blockSize;
+    heap->chunks.emplace_back(new unsigned char[CHUNK_SIZE]);
+    heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+
+    unsigned char* chunk = heap->chunks.back().get();
+    for(std::size_t i = 1; i < blocks; i++){
+        auto* freeBlock = reinterpret_cast<FreeBlock*>(chunk + i * blockSize);
+        freeBlock->next = heap->freeLists[sizeClass];
+        heap->freeLists[sizeClass] = freeBlock;
+    }
+    return chunk;
+}
+
+int64_t SlabAllocator::LiveBlocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t live = 0;
+    for(const std::unique_ptr<Heap>& heap : heaps_)
+        live += heap->allocated.load(std::memory_order_acquire) - heap->remoteFreed.load(std::memory_order_acquire);
+    return live;
+}
+
+// Must be called with orphansMutex held.
+void SlabAllocator::ReapOrphans() {
+    for(auto it = orphans.begin(); it != orphans.end();){
+        if((*it)->LiveBlocks() == 0){
+            delete *it;
+            it = orphans.erase(it);
+        } else
+            ++it;
+    }
+}
+
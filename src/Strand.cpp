@@ -0,0 +1,116 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <cstdio>
+#include <exception>
+#include <new>
+#include <thread>
+#include "Strand.h"
+#include "ThreadPool.h"
+
+Strand::Strand(ThreadPool& pool) : state_(std::make_shared<State>(&pool)) {}
+
+Strand::State::~State() {
+    // Left behind by a cancelling shutdown: never run.
+    while(Item* item = static_cast<Item*>(items.Pop())){
+        item->~Item();
+        SlabAllocator::Deallocate(item);
+    }
+}
+
+void Strand::Push(TaskFunction function) {
+    ThreadPool* pool = state_->pool;
+    if(pool->stopping_ && ThreadPool::currentPool_ != pool)
+        throw PoolShutdownError("ThreadPool is shutting down");
+
+    Item* item = ::new(pool->slab_->Allocate(sizeof(Item))) Item();
+    item->function = std::move(function);
+    state_->items.Push(item);
+    state_->pending.fetch_add(1);
+
+    // All sequentially consistent: either this thread raises the flag, or the drain sees the count.
+    if(!state_->scheduled.exchange(true))
+        Schedule(state_);
+}
+
+void Strand::Schedule(const std::shared_ptr<State>& state, bool handOff) {
+    try {
+        if(handOff){
+            std::shared_ptr<Task> task = state->pool->NewTask();
+            task->Bind([state](){ Drain(state); });
+            state->pool->HandOff(std::move(task));
+        } else
+            state->pool->Spawn([state](){ Drain(state); });
+    } catch(...) {
+        // Not scheduled after all (the pool is shutting down): whoever posts next tries again.
+        state->scheduled.store(false);
+        throw;
+    }
+}
+
+void Strand::Drain(const std::shared_ptr<State>& state) {
+    MpscQueue& items = state->items;
+    for(;;){
+        for(std::size_t ran = 0, spins = 0; ran < BURST; ){
+            auto* item = static_cast<Item*>(items.Pop());
+            if(!item){
+                if(items.Empty())
+                    break;
+                // A producer is in between its two steps: its item shows up once it is scheduled again.
+                if(++spins < 64)
+                    CPU_RELAX();
+                else
+                    std::this_thread::yield();
+                continue;
+            }
+            spins = 0;
+            state->pending.fetch_sub(1, std::memory_order_relaxed);
+
+            try {
+                item->function();
+            } catch(std::exception& e) {
+                TRACE_LOG("[EXCEPTION] %s", e.what());
+            } catch(...) {
+                // Whatever is thrown, the drain goes on: the flag is still up and nobody else would run the rest.
+                TRACE_LOG("[EXCEPTION] unknown exception");
+            }
+            item->~Item();
+            SlabAllocator::Deallocate(item);
+            ran++;
+        }
+
+        // Still busy: handed back to the pool as a new task, so that the worker serves other queues in between.
+        if(!items.Empty()){
+            Schedule(state, true);
+            return;
+        }
+
+        // The queue's consumer end belongs to whoever raises the flag next: only the count is looked at.
+        state->scheduled.store(false);
+        if(state->pending.load() <= 0 || state->scheduled.exchange(true))
+            return;
+    }
+}
+
+StrandGroup::StrandGroup(ThreadPool& pool, std::size_t strands) {
+    strands_.reserve(std::max<std::size_t>(strands, 1));
+    for(std::size_t i = 0; i < std::max<std::size_t>(strands, 1); i++)
+        strands_.emplace_back(pool);
+}
@@ -19,3 +19,12 @@
  */
 
 #include "Task.h"
+#include "ThreadPool.h"
+
+void Task::Wait() {
+    ThreadPool::HelpUntilDone(*this, nullptr);
+}
+
+bool Task::WaitUntil(std::chrono::steady_clock::time_point deadline) {
+    return ThreadPool::HelpUntilDone(*this, &deadline);
+}
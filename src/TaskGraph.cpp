@@ -0,0 +1,185 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+
+void TaskGraph::AddDependency(NodeId node, NodeId dependency) {
+    if(node >= nodes_.size() || dependency >= nodes_.size())
+        throw std::out_of_range("TaskGraph::AddDependency: unknown node");
+    if(node == dependency)
+        throw std::logic_error("TaskGraph::AddDependency: a node can not depend on itself");
+
+    nodes_[dependency]->successors.push_back(node);
+    sorted_ = false;
+}
+
+void TaskGraph::Run(ThreadPool& pool) {
+    if(nodes_.empty())
+        return;
+
+    Sort();
+
+    auto run = std::allocate_shared<RunState>(PooledAllocator<RunState>(pool.slab_));
+    run->pool = &pool;
+    run->remaining.store(static_cast<int64_t>(nodes_.size()), std::memory_order_relaxed);
+    for(NodeId id = 0; id < nodes_.size(); id++){
+        Node& node = *nodes_[id];
+        node.pending.store(node.predecessors, std::memory_order_relaxed);
+        node.run = run.get();
+        node.task = pool.NewTask();
+        node.task->Bind([this, run, id](){ RunNode(*run, id); });
+        node.task->OnCancel(&TaskGraph::Cancelled, &node);
+    }
+
+    for(NodeId root : roots_){
+        try {
+            pool.AddTask(nodes_[root]->task);
+        } catch(...) {
+            Skip(*run, root, std::current_exception());
+        }
+    }
+
+    ThreadPool::HelpUntilZero(run->remaining);
+
+    ComputeTimings();
+    if(run->exception)
+        std::rethrow_exception(run->exception);
+}
+
+std::size_t TaskGraph::CriticalPathLength() {
+    Sort();
+
+    std::vector<std::size_t> length(nodes_.size(), 1);
+    std::size_t longest = 0;
+    for(NodeId id : order_){
+        for(NodeId successor : nodes_[id]->successors)
+            length[successor] = std::max(length[successor], length[id] + 1);
+        longest = std::max(longest, length[id]);
+    }
+    return longest;
+}
+
+void TaskGraph::Sort() {
+    if(sorted_)
+        return;
+
+    for(std::unique_ptr<Node>& node : nodes_)
+        node->predecessors = 0;
+    for(std::unique_ptr<Node>& node : nodes_)
+        for(NodeId successor : node->successors)
+            nodes_[successor]->predecessors++;
+
+    // Kahn's algorithm; what can't be ordered is part of a cycle.
+    std::vector<uint32_t> pending(nodes_.size());
+    order_.clear();
+    roots_.clear();
+    for(NodeId id = 0; id < nodes_.size(); id++){
+        pending[id] = nodes_[id]->predecessors;
+        if(pending[id] == 0){
+            roots_.push_back(id);
+            order_.push_back(id);
+        }
+    }
+    for(std::size_t i = 0; i < order_.size(); i++){
+        for(NodeId successor : nodes_[order_[i]]->successors){
+            if(--pending[successor] == 0)
+                order_.push_back(successor);
+        }
+    }
+
+    if(order_.size() != nodes_.size())
+        throw std::logic_error("TaskGraph: the dependencies contain a cycle");
+
+    sorted_ = true;
+}
+
+void TaskGraph::RunNode(RunState& run, NodeId id) {
+    Node& node = *nodes_[id];
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        node.func();
+    } catch(...) {
+        run.Fail(std::current_exception());
+    }
+    node.duration = std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now() - start);
+
+    Release(run, id);
+    if(run.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        run.remaining.notify_all();
+}
+
+void TaskGraph::Release(RunState& run, NodeId id) {
+    for(NodeId successor : nodes_[id]->successors){
+        Node& next = *nodes_[successor];
+        if(next.pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            continue;
+        try {
+            // Handed off: once its roots are in, a full rejecting queue does not fail the run.
+            run.pool->HandOff(next.task);
+        } catch(...) {
+            Skip(run, successor, std::current_exception());
+        }
+    }
+}
+
+void TaskGraph::Skip(RunState& run, NodeId id, std::exception_ptr error) noexcept {
+    run.Fail(std::move(error));
+
+    // Iteratively: successors released by skipped nodes are skipped in turn.
+    std::vector<NodeId> skipped{id};
+    int64_t count = 0;
+    while(!skipped.empty()){
+        NodeId node = skipped.back();
+        skipped.pop_back();
+        count++;
+        nodes_[node]->duration = Duration(0);
+        for(NodeId successor : nodes_[node]->successors){
+            if(nodes_[successor]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                skipped.push_back(successor);
+        }
+    }
+
+    if(run.remaining.fetch_sub(count, std::memory_order_acq_rel) == count)
+        run.remaining.notify_all();
+}
+
+void TaskGraph::Cancelled(void* context) noexcept {
+    auto* node = static_cast<Node*>(context);
+    node->graph->Skip(*node->run, node->id, std::make_exception_ptr(PoolShutdownError("ThreadPool is shutting down")));
+}
+
+void TaskGraph::ComputeTimings() {
+    std::vector<Duration> finish(nodes_.size(), Duration(0));
+    criticalPathTime_ = Duration(0);
+    totalWork_ = Duration(0);
+
+    for(NodeId id : order_){
+        Node& node = *nodes_[id];
+        finish[id] += node.duration;
+        totalWork_ += node.duration;
+        criticalPathTime_ = std::max(criticalPathTime_, finish[id]);
+        for(NodeId successor : node.successors)
+            finish[successor] = std::max(finish[successor], finish[id]);
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <new>
+#include "TaskGroup.h"
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+    : pool_(&pool), state_(std::allocate_shared<State>(PooledAllocator<State>(pool.slab_))) {}
+
+TaskGroup::~TaskGroup() {
+    Join();
+}
+
+TaskGroup::State::~State() {
+    // Claimed by their tasks already (all gone by now): only Wait()'s reference is left.
+    while(Child* child = static_cast<Child*>(children.Pop()))
+        ReleaseChild(child);
+}
+
+void TaskGroup::Wait() {
+    Join();
+    if(!state_->failed.load(std::memory_order_acquire))
+        return;
+
+    std::exception_ptr exception = std::move(state_->exception);
+    state_->exception = nullptr;
+    state_->failed.store(false, std::memory_order_relaxed);
+    std::rethrow_exception(exception);
+}
+
+void TaskGroup::Join() {
+    // Children no worker has started yet are run right here, rather than waited for.
+    while(Child* child = static_cast<Child*>(state_->children.Pop()))
+        RunChild(child);
+
+    /*
+     * From a worker, the children it spawned are on top of its own deque: helping picks them
+     * first, then whatever else is pending, until the last child has finished.
+     */
+    ThreadPool::HelpUntilZero(state_->pending);
+}
+
+TaskGroup::Child* TaskGroup::NewChild() {
+    Child* child = ::new(pool_->slab_->Allocate(sizeof(Child))) Child();
+    child->state = state_.get();
+    return child;
+}
+
+void TaskGroup::RunChild(Child* child) noexcept {
+    if(!child->claimed.exchange(true, std::memory_order_acq_rel))
+        child->state->Invoke(child->function);
+    ReleaseChild(child);
+}
+
+void TaskGroup::ReleaseChild(Child* child) noexcept {
+    if(child->references.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        child->~Child();
+        SlabAllocator::Deallocate(child);
+    }
+}
+
+void TaskGroup::ChildCancelled(void* context) noexcept {
+    auto* child = static_cast<Child*>(context);
+    if(!child->claimed.exchange(true, std::memory_order_acq_rel))
+        child->state->Finished();
+    ReleaseChild(child);
+}
@@ -18,91 +18,1231 @@
  * @author - Geru-Scotland (https://github.com/geru-scotland)
  */
 
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(uint8_t num) : poolSize_(static_cast<uint8_t>(num)) {
-    /*
-     *   Initialize the thread pool
-     *
-     * - Use emplace_back instead of push_back to avoid unnecessary copies.
-     *   This directly constructs the thread object in the vector's memory.
-     *
-     * - A thread is created with the thread function and the 'this' pointer as arguments.
-     */
-    for(int i = 0; i < poolSize_; i++) {
-        pool_.emplace_back(&ThreadPool::ExecuteTask, this);
-        std::thread::id threadId = pool_.back().get_id();
-        threadIdMap_[threadId] = i;
-#ifdef DEBUG
-        std::cout << "Thread id: " << threadId << " associated to: "<< i << std::endl;
+thread_local ThreadPool* ThreadPool::currentPool_ = nullptr;
+thread_local int ThreadPool::currentWorker_ = -1;
+thread_local Task* ThreadPool::currentTask_ = nullptr;
+thread_local bool ThreadPool::handingOff_ = false;
+
+ThreadPool::ThreadPool(const ThreadPoolOptions& options, BuildFlags)
+    : schedulingPolicy_(options.scheduling), idlePolicy_(options.idlePolicy), spinIterations_(options.spinIterations),
+      yieldIterations_(options.yieldIterations), queueBackend_(options.queueBackend),
+      fullQueuePolicy_(options.fullQueuePolicy), queueCapacity_(0),
+      admissionControl_(options.maxPendingTasks > 0 || options.maxPendingBytes > 0),
+      maxPendingTasks_(static_cast<int64_t>(options.maxPendingTasks)),
+      maxPendingBytes_(static_cast<int64_t>(options.maxPendingBytes)), timers_(std::make_shared<TimerQueue>()),
+      timerEpoch_(std::chrono::steady_clock::now()),
+      timerTick_(std::max<std::chrono::nanoseconds>(std::chrono::nanoseconds(1), options.timerTick)),
+      elastic_(options.maxThreads > 0), minWorkers_(options.minThreads),
+      maxWorkers_(std::max(options.maxThreads, options.minThreads)),
+      scaleUpWait_(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(options.scaleUpWait).count())),
+      idleTimeout_(options.idleTimeout), maxSpareWorkers_(options.maxSpareThreads),
+#if THREADPOOL_TRACING
+      tracer_(options.traceCapacity), tracing_(options.tracing),
 #endif
+      topology_(Topology::Detect()), placement_(topology_.PlacementOrder(options.affinity, options.cpus)),
+      slab_(new SlabAllocator())
+{
+    for(std::size_t node = 0; node < topology_.GetNodeCount(); node++)
+        nodeQueues_.emplace_back(std::make_unique<NodeQueue>());
+    for(std::size_t priority = 0; priority < PRIORITY_CLASSES; priority++)
+        priorityWeights_[priority] = std::max(1u, options.priorityWeights[priority]);
+    priorityCredits_ = priorityWeights_;
+    if(queueBackend_ == QUEUE_LOCK_FREE){
+        for(std::unique_ptr<MpmcQueue<Task*>>& queue : boundedTasks_)
+            queue = std::make_unique<MpmcQueue<Task*>>(options.queueCapacity);
+        queueCapacity_ = static_cast<int64_t>(boundedTasks_[0]->Capacity());
     }
+
+    std::size_t threads = options.threads;
+    if(elastic_)
+        threads = std::clamp<std::size_t>(threads, minWorkers_, maxWorkers_);
+
+    UniqueLock lock(resizeMutex_);
+    for(std::size_t i = 0; i < threads; i++)
+        StartWorker();
 }
 
 /**
  * When destroying the object, properly stops all the threads in the pool before
- * freeing resources.
- *
- * Joining is mandatory for every thread to avoid zombie threads and resource leaks.
- * Note: It's essential to wait for each specific thread's execution to finish before
- * freeing its resources.
+ * freeing resources: every queued task is run first, as with Shutdown(DRAIN_ALL).
  */
 ThreadPool::~ThreadPool() {
-    // Don't need to lock mutex here, worst case scenario, we will have an extra iteration
-    while(poolActive_){
-        {
-            if(tasks_.empty()){
-                /**
-                 * Since std::thread::joinable doesn't check this, we need to have in mind a few things:
-                 *
-                 * Before the joining and resource cleaning, we need to wake up all threads.
-                 * std::thread::join waits for the thread's current execution to finish. It will be
-                 * woken up when it gets notified AND the predicate is true. If we try to
-                 * perform the joining on a thread which execution is in constant loop,
-                 * that joining will keep waiting forever, and the object will not be destroyed.
-                 * which will end in the system being frozen.
-                 *
-                 * Note: poolActive needs to be set to false before sending the
-                 * notifications, as it forms part of the condition for the predicate;
-                 * if it is set to true, it shall not wake up, therefore the thread will hang.
-                 */
-                poolActive_ = false;
-                cv_.notify_all();
+    Shutdown(DRAIN_ALL);
+    slab_->Release();
+}
+
+void ThreadPool::WaitIdle() {
+    if(currentPool_ == this)
+        throw std::logic_error("ThreadPool::WaitIdle() called from one of the pool's workers");
+    WaitIdleUntil(nullptr);
+}
+
+bool ThreadPool::WaitIdleUntil(const TimePoint* deadline) {
+    auto idle = [this](){ return unfinishedTasks_ <= 0; };
+
+    UniqueLock lock(mutex_);
+    idleWaiters_++;
+    bool isIdle = true;
+    if(deadline)
+        isIdle = idleCv_.wait_until(lock, *deadline, idle);
+    else
+        idleCv_.wait(lock, idle);
+    idleWaiters_--;
+    return isIdle;
+}
+
+void ThreadPool::TasksFinished(int64_t count) {
+    // Both sequentially consistent: either this thread sees the waiter, or the waiter sees zero.
+    if(unfinishedTasks_.fetch_sub(count) == count && idleWaiters_ > 0){
+        UniqueLock lock(mutex_);
+        idleCv_.notify_all();
+    }
+}
+
+ThreadPool::Submission::Submission(ThreadPool& pool, int64_t count) {
+    if(currentPool_ == &pool)
+        return;
+    pool.submitting_++;
+    if(pool.stopping_){
+        pool.submitting_--;
+        pool.rejectedTasks_.fetch_add(static_cast<uint64_t>(count), std::memory_order_relaxed);
+        throw PoolShutdownError("ThreadPool is shutting down");
+    }
+    submitting_ = &pool.submitting_;
+}
+
+ThreadPool::Submission::~Submission() {
+    if(submitting_)
+        (*submitting_)--;
+}
+
+void ThreadPool::Shutdown(DrainMode mode) {
+    ShutdownUntil(mode, nullptr);
+}
+
+bool ThreadPool::ShutdownUntil(DrainMode mode, const TimePoint* deadline) {
+    if(currentPool_ == this)
+        throw std::logic_error("ThreadPool::Shutdown() called from one of the pool's workers");
+
+    UniqueLock shutdownLock(shutdownMutex_);
+    if(shutDown_)
+        return true;
+
+    // Producers waiting for room find out they are being turned away.
+    {
+        UniqueLock lock(mutex_);
+        stopping_ = true;
+        roomCv_.notify_all();
+    }
+    StopTimers();
+
+    // Producers that got past the flag before it was raised finish queuing their tasks first.
+    while(submitting_ > 0)
+        std::this_thread::yield();
+
+    // Workers keep running tasks (and those they spawn) meanwhile.
+    if(mode == DRAIN_ALL)
+        WaitIdleUntil(deadline);
+
+    /**
+     * Workers check poolActive_ before taking every task, and it is part of the predicate
+     * they sleep on. It is set under the lock, so no worker can be in between checking the
+     * predicate and going to sleep when they are notified.
+     */
+    {
+        UniqueLock lock(mutex_);
+        poolActive_ = false;
+        cv_.notify_all();
+    }
+
+    /*
+     * Resize() and ScaleUp() check poolActive_ under resizeMutex_, so once it has been
+     * taken here no worker can be started anymore. It is not held while joining, a task
+     * still running could be calling Resize().
+     */
+    { UniqueLock resizeLock(resizeMutex_); }
+    for(std::unique_ptr<Worker>& worker : workers_){
+        if(worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    /*
+     * Whatever is still queued now never runs: cancelled (so that nobody waits on it forever)
+     * and dropped, along with the ownership it holds on itself.
+     */
+    int64_t cancelled = 0;
+    auto cancel = [this, &cancelled](Task* task){
+        if(admissionControl_)
+            Discharge(task);
+        std::shared_ptr<Task> owner = task->Release();
+        task->Cancel();
+        cancelled++;
+    };
+    for(std::unique_ptr<Worker>& worker : workers_){
+        while(Task* task = worker->tasks.Pop())
+            cancel(task);
+    }
+    for(TasksQueue& queue : tasks_){
+        while(!queue.empty()){
+            cancel(queue.front());
+            queue.pop();
+        }
+    }
+    for(std::unique_ptr<MpmcQueue<Task*>>& queue : boundedTasks_){
+        Task* task;
+        while(queue && queue->TryPop(task))
+            cancel(task);
+    }
+    for(std::unique_ptr<NodeQueue>& queue : nodeQueues_){
+        while(!queue->tasks.empty()){
+            cancel(queue->tasks.front());
+            queue->tasks.pop();
+        }
+        queue->size = 0;
+    }
+    pendingTasks_ = 0;
+    sharedTasks_ = 0;
+    for(AtomicCounter& size : priorityTasks_)
+        size = 0;
+    if(cancelled > 0){
+        cancelledTasks_.fetch_add(static_cast<uint64_t>(cancelled), std::memory_order_relaxed);
+        TasksFinished(cancelled);
+    }
+
+    shutDown_ = true;
+    return cancelled == 0;
+}
+
+uint64_t ThreadPool::TimerTick(TimePoint time, bool roundUp) const noexcept {
+    if(time <= timerEpoch_)
+        return 0;
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(time - timerEpoch_);
+    auto ticks = static_cast<uint64_t>(elapsed / timerTick_);
+    return roundUp && elapsed % timerTick_ != std::chrono::nanoseconds::zero() ? ticks + 1 : ticks;
+}
+
+TimerHandle ThreadPool::AddTimer(TimePoint time, uint64_t period, std::shared_ptr<TimerHandle::State> state) {
+    state->period = period;
+    UniqueLock lock(timers_->mutex);
+    if(timers_->stopped){
+        rejectedTasks_.fetch_add(1, std::memory_order_relaxed);
+        throw PoolShutdownError("ThreadPool is shutting down");
+    }
+    if(!timerThread_.joinable())
+        timerThread_ = std::thread(&ThreadPool::RunTimers, this);
+    ArmTimer(state, TimerTick(time, true));
+    return TimerHandle(std::move(state));
+}
+
+void ThreadPool::ArmTimer(const std::shared_ptr<TimerHandle::State>& state, uint64_t expiry) {
+    timers_->wheel.Insert(state.get(), expiry);
+    state->self = state;
+    if(timers_->wakeTick != 0 && state->expiry < timers_->wakeTick)
+        timers_->cv.notify_one();
+}
+
+void ThreadPool::RearmTimer(const std::shared_ptr<TimerHandle::State>& state) {
+    if(state->period == 0)
+        return;
+
+    uint64_t now = TimerTick(std::chrono::steady_clock::now(), false);
+    UniqueLock lock(timers_->mutex);
+    if(!state->active || state->IsLinked())
+        return;
+    if(timers_->stopped){
+        state->active = false;
+        return;
+    }
+    uint64_t expiry = state->expiry + state->period;
+    if(expiry <= now)
+        expiry += ((now - expiry) / state->period + 1) * state->period;
+    ArmTimer(state, expiry);
+}
+
+void ThreadPool::FireTimer(const std::shared_ptr<TimerHandle::State>& state) {
+    std::shared_ptr<Task> task = NewTask();
+    task->Bind([this, state](){
+        // A run that throws does not stop a periodic timer either.
+        try {
+            state->function();
+        } catch(...) {
+            RearmTimer(state);
+            throw;
+        }
+        RearmTimer(state);
+    });
+    task->SetOptions(state->options);
+    task->OnCancel(&TimerHandle::Cancelled, state.get());
+
+    try {
+        AddTask(std::move(task));
+    } catch(const QueueFullError&) {
+        // Rejected (and counted as such): only that run is lost.
+        RearmTimer(state);
+    } catch(const PoolShutdownError&) {
+    }
+}
+
+void ThreadPool::RunTimers() {
+    std::vector<TimerWheel::Entry*> expired;
+    std::vector<std::shared_ptr<TimerHandle::State>> due;
+
+    UniqueLock lock(timers_->mutex);
+    while(!timers_->stopped){
+        timers_->wheel.Advance(TimerTick(std::chrono::steady_clock::now(), false), expired);
+        if(!expired.empty()){
+            for(TimerWheel::Entry* entry : expired){
+                auto* state = static_cast<TimerHandle::State*>(entry);
+                if(state->period == 0)
+                    state->active = false;
+                due.emplace_back(std::move(state->self));
+            }
+            expired.clear();
+
+            // Adding a task may have to wait for room, Cancel() is not kept waiting meanwhile.
+            lock.unlock();
+            for(const std::shared_ptr<TimerHandle::State>& state : due)
+                FireTimer(state);
+            due.clear();
+            lock.lock();
+            continue;
+        }
+
+        uint64_t next = timers_->wheel.NextEvent();
+        timers_->wakeTick = next;
+        if(next == TimerWheel::NEVER)
+            timers_->cv.wait(lock);
+        else
+            timers_->cv.wait_until(lock, timerEpoch_ + timerTick_ * static_cast<int64_t>(next));
+        timers_->wakeTick = 0;
+    }
+}
+
+void ThreadPool::StopTimers() {
+    std::vector<TimerWheel::Entry*> entries;
+    std::vector<std::shared_ptr<TimerHandle::State>> owners;
+    {
+        UniqueLock lock(timers_->mutex);
+        timers_->stopped = true;
+        timers_->wheel.Clear(entries);
+        for(TimerWheel::Entry* entry : entries){
+            auto* state = static_cast<TimerHandle::State*>(entry);
+            state->active = false;
+            owners.emplace_back(std::move(state->self));
+        }
+        timers_->cv.notify_all();
+    }
+
+    // Not under the lock: the thread may be handing its last timers to the queues.
+    if(timerThread_.joinable())
+        timerThread_.join();
+}
+
+ThreadPool::Worker& ThreadPool::StartWorker() {
+    ReapWorkers();
+
+    std::size_t slot = 0;
+    std::size_t count = slotCount_.load(std::memory_order_relaxed);
+    Worker** slots = slots_.load(std::memory_order_relaxed);
+    while(slot < count && (slots[slot]->active || slots[slot]->thread.joinable()))
+        slot++;
+
+    if(slot == count){
+        /*
+         * No free slot: a new Worker goes at the end, in a bigger copy of the slot array if
+         * needed. The array is published before the count that makes the slot visible.
+         */
+        if(count == slotCapacity_){
+            slotCapacity_ = std::max<std::size_t>(8, slotCapacity_ * 2);
+            slotArrays_.emplace_back(new Worker*[slotCapacity_]);
+            std::copy(slots, slots + count, slotArrays_.back().get());
+            slots = slotArrays_.back().get();
+            slots_.store(slots, std::memory_order_release);
+        }
+        workers_.emplace_back(std::make_unique<Worker>());
+        // A slot always runs on the same CPU, so thieves can read its locality without locking.
+        if(!placement_.empty()){
+            const Topology::Cpu* cpu = topology_.Find(placement_[slot % placement_.size()]);
+            workers_.back()->cpu = cpu->id;
+            workers_.back()->node = cpu->node;
+            workers_.back()->l3 = cpu->l3;
+        }
+        slots[slot] = workers_.back().get();
+        slotCount_.store(count + 1, std::memory_order_release);
+    }
+
+    /*
+     * Worker state has to be ready before its thread starts, since workers steal
+     * from each other as soon as they are up.
+     */
+    Worker& worker = *slots[slot];
+    worker.stealSeed = static_cast<uint32_t>(slot) * 2654435761u + 1;
+    worker.spinBudget = idlePolicy_ == IDLE_ADAPTIVE ? spinIterations_ / 16 : spinIterations_;
+    worker.localStreak = 0;
+    worker.priorityCredits = priorityWeights_;
+    worker.retiring = false;
+    worker.exited = false;
+    worker.active = true;
+    worker.spare = false;
+    activeWorkers_++;
+
+    // A thread is created with the thread function, the 'this' pointer and its worker id as arguments.
+    try {
+        worker.thread = std::thread(&ThreadPool::ExecuteTask, this, static_cast<int>(slot));
+    } catch(...) {
+        // Out of threads: the slot stays free.
+        worker.active = false;
+        activeWorkers_--;
+        throw;
+    }
+    std::thread::id threadId = worker.thread.get_id();
+    threadIdMap_[threadId] = static_cast<int>(slot);
+#ifdef DEBUG
+    std::cout << "Thread id: " << threadId << " associated to: "<< slot << std::endl;
+#endif
+    return worker;
+}
+
+void ThreadPool::ReapWorkers() {
+    for(std::unique_ptr<Worker>& worker : workers_){
+        if(!worker->active && worker->exited && worker->thread.joinable()){
+            threadIdMap_.erase(worker->thread.get_id());
+            worker->thread.join();
+        }
+    }
+}
+
+void ThreadPool::Resize(std::size_t count) {
+    // With no worker left nothing would ever run the queued tasks, and WaitIdle() would hang.
+    if(count == 0)
+        throw std::invalid_argument("ThreadPool::Resize() needs at least one worker");
+
+    UniqueLock resizeLock(resizeMutex_);
+    if(!poolActive_)
+        return;
+
+    while(GetWorkerCount() < count)
+        StartWorker();
+
+    std::size_t slots = slotCount_.load(std::memory_order_relaxed);
+    bool retired = false;
+    for(std::size_t slot = slots; slot-- > 0 && GetWorkerCount() > count; ){
+        Worker& worker = WorkerAt(static_cast<int>(slot));
+        if(!worker.active || (currentPool_ == this && currentWorker_ == static_cast<int>(slot)))
+            continue;
+        Retire(worker);
+        retired = true;
+    }
+
+    // Under the lock: a retiring worker either sees the flag in its predicate or gets notified.
+    if(retired){
+        UniqueLock lock(mutex_);
+        cv_.notify_all();
+    }
+}
+
+void ThreadPool::ScaleUp() {
+    if(GetWorkerCount() >= maxWorkers_)
+        return;
+
+    uint64_t now = SteadyNanoseconds();
+    uint64_t last = lastScaleUp_.load(std::memory_order_relaxed);
+    if(now - last < scaleUpWait_ || !lastScaleUp_.compare_exchange_strong(last, now))
+        return;
+
+    UniqueLock resizeLock(resizeMutex_, std::try_to_lock);
+    if(resizeLock.owns_lock() && poolActive_ && GetWorkerCount() < maxWorkers_)
+        StartWorker();
+}
+
+bool ThreadPool::TryRetire(Worker& worker) {
+    UniqueLock resizeLock(resizeMutex_, std::try_to_lock);
+    if(!resizeLock.owns_lock() || !worker.active || GetWorkerCount() <= std::max<std::size_t>(minWorkers_, 1))
+        return false;
+
+    Retire(worker);
+    return true;
+}
+
+void ThreadPool::Retire(Worker& worker) {
+    worker.active = false;
+    worker.retiring = true;
+    activeWorkers_--;
+    if(worker.spare){
+        worker.spare = false;
+        spareWorkers_--;
+    }
+}
+
+void ThreadPool::BeginBlocking(int workerId) noexcept {
+    if(WorkerAt(workerId).blocking.fetch_add(1, std::memory_order_relaxed) > 0)
+        return;
+    int64_t blocked = ++blockedWorkers_;
+    if(spareWorkers_ >= blocked || spareWorkers_ >= static_cast<int64_t>(maxSpareWorkers_))
+        return;
+
+    UniqueLock resizeLock(resizeMutex_);
+    if(!poolActive_ || spareWorkers_ >= blockedWorkers_ || spareWorkers_ >= static_cast<int64_t>(maxSpareWorkers_))
+        return;
+    try {
+        StartWorker().spare = true;
+        spareWorkers_++;
+        compensations_.fetch_add(1, std::memory_order_relaxed);
+    } catch(...) {
+        // No thread to spare: the blocked worker is simply not made up for.
+    }
+}
+
+void ThreadPool::EndBlocking(int workerId) noexcept {
+    if(WorkerAt(workerId).blocking.fetch_sub(1, std::memory_order_relaxed) > 1)
+        return;
+    int64_t blocked = --blockedWorkers_;
+    if(spareWorkers_ <= blocked)
+        return;
+
+    bool retired = false;
+    {
+        UniqueLock resizeLock(resizeMutex_);
+        if(!poolActive_)
+            return;
+        // Any spare that is not blocked itself will do, the calling one included: workers are interchangeable.
+        std::size_t slots = slotCount_.load(std::memory_order_relaxed);
+        for(std::size_t slot = slots; slot-- > 0 && spareWorkers_ > blockedWorkers_; ){
+            Worker& worker = WorkerAt(static_cast<int>(slot));
+            if(worker.active && worker.spare && worker.blocking.load(std::memory_order_relaxed) == 0){
+                Retire(worker);
+                retired = true;
+            }
+        }
+    }
+
+    // Under the lock: a retiring worker either sees the flag in its predicate or gets notified.
+    if(retired){
+        UniqueLock lock(mutex_);
+        cv_.notify_all();
+    }
+}
+
+int ThreadPool::GetWorkerId(std::thread::id threadId) const {
+    UniqueLock resizeLock(resizeMutex_);
+    auto it = threadIdMap_.find(threadId);
+    return it != threadIdMap_.end() ? it->second : -1;
+}
+
+bool ThreadPool::AddTask(std::shared_ptr<Task> task, const TimePoint* deadline) {
+    bool handOff = std::exchange(handingOff_, false);
+    Submission submission(*this, 1);
+    if(admissionControl_ && !Admit(1, static_cast<int64_t>(task->GetCapturedSize()), deadline))
+        return false;
+    unfinishedTasks_++;
+
+    Task* rawTask = task.get();
+    rawTask->Retain(std::move(task));
+    uint64_t now = THREADPOOL_METRICS || elastic_ ? SteadyNanoseconds() : 0;
+    rawTask->MarkEnqueued(now);
+    Trace(TRACE_ENQUEUE, rawTask);
+
+    TaskPriority priority = rawTask->GetPriority();
+    int node = rawTask->GetNode();
+    if(PushesLocally(priority, node)){
+        WorkerAt(currentWorker_).tasks.Push(rawTask);
+        pendingTasks_++;
+        /*
+         * Both counters are sequentially consistent: either this thread sees the
+         * sleeper, or the sleeper sees the pending task before going to sleep.
+         */
+        if(sleepingWorkers_ > 0){
+            UniqueLock lock(mutex_);
+            cv_.notify_one();
+        }
+        return true;
+    }
+
+    if(IsNode(node)){
+        PushToNode({rawTask}, node);
+        return true;
+    }
+
+    if(queueBackend_ == QUEUE_LOCK_FREE){
+        PushBounded(&rawTask, 1, priority, handOff);
+        return true;
+    }
+
+    bool starving;
+    {
+        UniqueLock lock(mutex_);
+        tasks_[priority].emplace(rawTask);
+        priorityTasks_[priority]++;
+        sharedTasks_++;
+        pendingTasks_++;
+        if(sleepingWorkers_ > 0)
+            cv_.notify_one();
+
+        // Nobody idle and the oldest task of the class has been waiting for too long.
+        starving = elastic_ && sleepingWorkers_ == 0 &&
+                   (GetWorkerCount() == 0 || now - tasks_[priority].front()->GetEnqueuedAt() > scaleUpWait_);
+    }
+    if(starving)
+        ScaleUp();
+    return true;
+}
+
+void ThreadPool::HandOff(std::shared_ptr<Task> task) {
+    handingOff_ = true;
+    AddTask(std::move(task));
+}
+
+void ThreadPool::AddTasks(const std::vector<std::shared_ptr<Task>>& tasks) {
+    if(tasks.empty())
+        return;
+
+    auto count = static_cast<int64_t>(tasks.size());
+    Submission submission(*this, count);
+    if(admissionControl_){
+        int64_t bytes = 0;
+        for(const std::shared_ptr<Task>& task : tasks)
+            bytes += static_cast<int64_t>(task->GetCapturedSize());
+        Admit(count, bytes, nullptr);
+    }
+    unfinishedTasks_ += count;
+    uint64_t now = THREADPOOL_METRICS || elastic_ ? SteadyNanoseconds() : 0;
+    for(const std::shared_ptr<Task>& task : tasks){
+        task->MarkEnqueued(now);
+        Trace(TRACE_ENQUEUE, task.get());
+    }
+    for(const std::shared_ptr<Task>& task : tasks)
+        task->Retain(task);
+
+    TaskPriority priority = tasks.front()->GetPriority();
+    int node = tasks.front()->GetNode();
+    if(PushesLocally(priority, node)){
+        Worker& worker = WorkerAt(currentWorker_);
+        for(const std::shared_ptr<Task>& task : tasks)
+            worker.tasks.Push(task.get());
+        pendingTasks_ += count;
+        if(sleepingWorkers_ > 0){
+            UniqueLock lock(mutex_);
+            WakeWorkers(count);
+        }
+        return;
+    }
+
+    if(IsNode(node)){
+        std::vector<Task*> rawTasks;
+        rawTasks.reserve(tasks.size());
+        for(const std::shared_ptr<Task>& task : tasks)
+            rawTasks.push_back(task.get());
+        PushToNode(rawTasks, node);
+        return;
+    }
+
+    if(queueBackend_ == QUEUE_LOCK_FREE){
+        std::vector<Task*> rawTasks;
+        rawTasks.reserve(tasks.size());
+        for(const std::shared_ptr<Task>& task : tasks)
+            rawTasks.push_back(task.get());
+        PushBounded(rawTasks.data(), count, priority);
+        return;
+    }
+
+    bool starving;
+    {
+        UniqueLock lock(mutex_);
+        for(const std::shared_ptr<Task>& task : tasks)
+            tasks_[priority].emplace(task.get());
+        priorityTasks_[priority] += count;
+        sharedTasks_ += count;
+        pendingTasks_ += count;
+        WakeWorkers(count);
+
+        starving = elastic_ && sleepingWorkers_ < count &&
+                   (GetWorkerCount() == 0 || now - tasks_[priority].front()->GetEnqueuedAt() > scaleUpWait_);
+    }
+    if(starving)
+        ScaleUp();
+}
+
+bool ThreadPool::ReserveAdmission(int64_t tasks, int64_t bytes) noexcept {
+    int64_t current = admittedTasks_.load(std::memory_order_relaxed);
+    do {
+        if(current > 0 && maxPendingTasks_ > 0 && current + tasks > maxPendingTasks_)
+            return false;
+    } while(!admittedTasks_.compare_exchange_weak(current, current + tasks));
+
+    // Oversized requests still get in alone: the task count above was 0 then.
+    if(current > 0 && maxPendingBytes_ > 0 && admittedBytes_.load() + bytes > maxPendingBytes_){
+        admittedTasks_ -= tasks;
+        NotifyRoom();
+        return false;
+    }
+    admittedBytes_ += bytes;
+    return true;
+}
+
+bool ThreadPool::Admit(int64_t tasks, int64_t bytes, const TimePoint* deadline) {
+    while(!ReserveAdmission(tasks, bytes)){
+        if(stopping_ && currentPool_ != this){
+            rejectedTasks_.fetch_add(static_cast<uint64_t>(tasks), std::memory_order_relaxed);
+            throw PoolShutdownError("ThreadPool is shutting down");
+        }
+        if(deadline && std::chrono::steady_clock::now() >= *deadline){
+            rejectedTasks_.fetch_add(static_cast<uint64_t>(tasks), std::memory_order_relaxed);
+            return false;
+        }
+
+        // Workers help instead of waiting, the pool might otherwise be full of producers.
+        if(currentPool_ == this){
+            if(Task* task = NextTask(currentWorker_))
+                RunTask(task, currentWorker_);
+            else
+                std::this_thread::yield();
+            continue;
+        }
+
+        UniqueLock lock(mutex_);
+        waitingProducers_++;
+        auto room = [this, tasks, bytes](){
+            int64_t admitted = admittedTasks_;
+            return stopping_ || admitted == 0 || ((maxPendingTasks_ == 0 || admitted + tasks <= maxPendingTasks_) &&
+                                     (maxPendingBytes_ == 0 || admittedBytes_ + bytes <= maxPendingBytes_));
+        };
+        if(deadline)
+            roomCv_.wait_until(lock, *deadline, room);
+        else
+            roomCv_.wait(lock, room);
+        waitingProducers_--;
+    }
+    return true;
+}
+
+void ThreadPool::Discharge(const Task* task) {
+    admittedBytes_ -= static_cast<int64_t>(task->GetCapturedSize());
+    admittedTasks_--;
+    NotifyRoom();
+}
+
+void ThreadPool::NotifyRoom() {
+    if(waitingProducers_ > 0){
+        UniqueLock lock(mutex_);
+        roomCv_.notify_all();
+    }
+}
+
+void ThreadPool::WakeWorkers(int64_t count) {
+    int64_t sleeping = sleepingWorkers_;
+    if(sleeping <= 0)
+        return;
+
+    if(count >= sleeping)
+        cv_.notify_all();
+    else {
+        for(int64_t i = 0; i < count; i++)
+            cv_.notify_one();
+    }
+}
+
+bool ThreadPool::ReserveBounded(TaskPriority priority, int64_t count) noexcept {
+    AtomicCounter& size = priorityTasks_[priority];
+    int64_t current = size.load(std::memory_order_relaxed);
+    do {
+        if(current + count > queueCapacity_)
+            return false;
+    } while(!size.compare_exchange_weak(current, current + count));
+    return true;
+}
+
+void ThreadPool::PushBounded(Task* const* tasks, int64_t count, TaskPriority priority, bool handOff) {
+    /*
+     * A group bigger than the whole queue goes in pieces (it could never be reserved at once),
+     * unless the policy is to reject: then it is all or nothing.
+     */
+    bool reject = fullQueuePolicy_ == FULL_QUEUE_REJECT && !(handOff && currentPool_ == this);
+    int64_t piece = reject ? count : std::min(count, queueCapacity_);
+    for(int64_t pushed = 0; pushed < count; pushed += piece){
+        piece = std::min(piece, count - pushed);
+
+        while(!ReserveBounded(priority, piece)){
+            bool shuttingDown = stopping_ && currentPool_ != this;
+            if(reject || shuttingDown){
+                // The tasks are still the caller's, they just give up the ownership they took on themselves.
+                for(int64_t i = pushed; i < count; i++){
+                    if(admissionControl_)
+                        Discharge(tasks[i]);
+                    tasks[i]->Release();
+                }
+                rejectedTasks_.fetch_add(static_cast<uint64_t>(count - pushed), std::memory_order_relaxed);
+                TasksFinished(count - pushed);
+                if(shuttingDown)
+                    throw PoolShutdownError("ThreadPool is shutting down");
+                throw QueueFullError(std::string("Task queue full: ") + PriorityName(priority));
+            }
+
+            // Workers help instead of waiting, the pool might otherwise be full of producers.
+            if(currentPool_ == this){
+                if(Task* task = NextTask(currentWorker_)){
+                    RunTask(task, currentWorker_);
+                    continue;
+                }
+            }
+            if(fullQueuePolicy_ == FULL_QUEUE_SPIN || currentPool_ == this){
+                std::this_thread::yield();
+                continue;
             }
+
+            UniqueLock lock(mutex_);
+            waitingProducers_++;
+            roomCv_.wait(lock, [this, priority, piece](){ return stopping_ || priorityTasks_[priority] + piece <= queueCapacity_; });
+            waitingProducers_--;
+        }
+
+        // Counted before being published, so that pendingTasks_ never goes below zero.
+        sharedTasks_ += piece;
+        pendingTasks_ += piece;
+        MpmcQueue<Task*>& queue = *boundedTasks_[priority];
+        for(int64_t i = pushed; i < pushed + piece; i++){
+            // Room is reserved, a failure only means a consumer is still leaving that cell.
+            while(!queue.TryPush(tasks[i]))
+                CPU_RELAX();
         }
+
+        if(sleepingWorkers_ > 0){
+            UniqueLock lock(mutex_);
+            WakeWorkers(piece);
+        }
+    }
+
+    if(elastic_ && GetWorkerCount() == 0)
+        ScaleUp();
+}
+
+Task* ThreadPool::PopBounded(int workerId) {
+    Worker& worker = WorkerAt(workerId);
+
+    for(int round = 0; round < 2; round++){
+        for(std::size_t priority = 0; priority < PRIORITY_CLASSES; priority++){
+            if(worker.priorityCredits[priority] == 0 || priorityTasks_[priority].load(std::memory_order_relaxed) <= 0)
+                continue;
+
+            Task* task;
+            if(!boundedTasks_[priority]->TryPop(task))
+                continue;
+            worker.priorityCredits[priority]--;
+            priorityTasks_[priority]--;
+            sharedTasks_--;
+            NotifyRoom();
+            return task;
+        }
+        worker.priorityCredits = priorityWeights_;
+    }
+    return nullptr;
+}
+
+void ThreadPool::PushToNode(const std::vector<Task*>& tasks, int node) {
+    NodeQueue& queue = *nodeQueues_[node];
+    {
+        UniqueLock lock(queue.mutex);
+        for(Task* task : tasks)
+            queue.tasks.emplace(task);
+        queue.size += static_cast<int64_t>(tasks.size());
     }
+    pendingTasks_ += static_cast<int64_t>(tasks.size());
 
-    for(std::thread& thread : pool_){
-        if(thread.joinable())
-            thread.join();
+    if(sleepingWorkers_ > 0){
+        UniqueLock lock(mutex_);
+        WakeWorkers(static_cast<int64_t>(tasks.size()));
     }
 }
 
+Task* ThreadPool::PopFromNode(int node) {
+    NodeQueue& queue = *nodeQueues_[node];
+    if(queue.size <= 0)
+        return nullptr;
+
+    UniqueLock lock(queue.mutex);
+    if(queue.tasks.empty())
+        return nullptr;
+    Task* task = queue.tasks.front();
+    queue.tasks.pop();
+    queue.size--;
+    return task;
+}
+
+Task* ThreadPool::NextTask(int workerId) {
+    Worker& worker = WorkerAt(workerId);
+    Task* task = nullptr;
+
+    if(sharedTasks_ > 0 && (priorityTasks_[PRIORITY_REALTIME] > 0 || ++worker.localStreak >= LOCAL_BURST)){
+        worker.localStreak = 0;
+        task = PopShared(workerId);
+    }
+
+    if(!task)
+        task = worker.tasks.Pop();
+
+    if(!task && worker.node >= 0)
+        task = PopFromNode(worker.node);
+
+    if(!task && sharedTasks_ > 0)
+        task = PopShared(workerId);
+
+    if(!task && schedulingPolicy_ == SCHEDULING_WORK_STEALING)
+        task = StealTask(workerId);
+
+    for(std::size_t node = 0; !task && node < nodeQueues_.size(); node++)
+        task = PopFromNode(static_cast<int>(node));
+
+    if(task){
+        Trace(TRACE_DEQUEUE, task);
+        pendingTasks_--;
+        if(admissionControl_)
+            Discharge(task);
+        if(elastic_ && SteadyNanoseconds() - task->GetEnqueuedAt() > scaleUpWait_)
+            ScaleUp();
+    }
+
+    return task;
+}
+
+Task* ThreadPool::PopShared(int workerId) {
+    if(queueBackend_ == QUEUE_LOCK_FREE)
+        return PopBounded(workerId);
+
+#if THREADPOOL_METRICS
+    UniqueLock lock(mutex_, std::try_to_lock);
+    if(!lock.owns_lock()){
+        WorkerMetrics::Add(WorkerAt(workerId).metrics.lockContentions, 1);
+        lock.lock();
+    }
+#else
+    UniqueLock lock(mutex_);
+#endif
+
+    // Second round only after a refill, when every class with work had run out of credits.
+    for(int round = 0; round < 2; round++){
+        for(std::size_t priority = 0; priority < PRIORITY_CLASSES; priority++){
+            TasksQueue& queue = tasks_[priority];
+            if(queue.empty() || priorityCredits_[priority] == 0)
+                continue;
+
+            Task* task = queue.front();
+            queue.pop();
+            priorityCredits_[priority]--;
+            priorityTasks_[priority]--;
+            sharedTasks_--;
+            return task;
+        }
+        priorityCredits_ = priorityWeights_;
+    }
+    return nullptr;
+}
+
+Task* ThreadPool::StealTask(int workerId) {
+    std::size_t count = slotCount_.load(std::memory_order_acquire);
+    if(count < 2)
+        return nullptr;
+    Worker** slots = slots_.load(std::memory_order_acquire);
+    Worker& thief = *slots[workerId];
+
+    // Xorshift, so that thieves don't all go for the same victim.
+    uint32_t& seed = thief.stealSeed;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    // 0: same L3 cache, 1: same node, 2: elsewhere.
+    auto distance = [&thief](const Worker& victim){
+        if(thief.l3 >= 0 && victim.l3 == thief.l3 && victim.node == thief.node)
+            return 0;
+        return victim.node == thief.node ? 1 : 2;
+    };
+
+    std::size_t start = seed % count;
+    int passes = thief.node < 0 ? 1 : 3;
+    for(int pass = 0; pass < passes; pass++){
+        for(std::size_t i = 0; i < count; i++){
+            std::size_t victim = (start + i) % count;
+            if(victim == static_cast<std::size_t>(workerId) || (passes > 1 && distance(*slots[victim]) != pass))
+                continue;
+            if(Task* task = slots[victim]->tasks.Steal()){
+#if THREADPOOL_METRICS
+                WorkerMetrics::Add(thief.metrics.steals, 1);
+#endif
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+Task* ThreadPool::SpinForTask(int workerId) {
+    if(idlePolicy_ == IDLE_PARK)
+        return nullptr;
+
+    Worker& worker = WorkerAt(workerId);
+    Task* task = nullptr;
+
+    for(uint32_t i = 0; i < worker.spinBudget && !task && poolActive_; i++){
+        // Only the shared counter is polled, queues are looked at once it says there is work.
+        if(pendingTasks_.load(std::memory_order_relaxed) > 0)
+            task = NextTask(workerId);
+        else
+            CPU_RELAX();
+    }
+
+    for(uint32_t i = 0; i < yieldIterations_ && !task && poolActive_; i++){
+        std::this_thread::yield();
+        if(pendingTasks_.load(std::memory_order_relaxed) > 0)
+            task = NextTask(workerId);
+    }
+
+    if(idlePolicy_ == IDLE_ADAPTIVE){
+        if(task)
+            worker.spinBudget = std::min(spinIterations_, worker.spinBudget * 2 + 1);
+        else
+            worker.spinBudget /= 2;
+    }
+    return task;
+}
+
+void ThreadPool::RunTask(Task* task, int workerId) {
+    std::shared_ptr<Task> owner = task->Release();
+    task->AssociateThread(workerId);
+
+    // Stopped or expired while queued: dropped right here, nobody is waiting for its result anymore.
+    if(task->IsCancellable()){
+        bool stopped = task->StopRequested();
+        if(stopped || task->IsExpired(SteadyNanoseconds())){
+            (stopped ? cancelledTasks_ : expiredTasks_).fetch_add(1, std::memory_order_relaxed);
+            task->Cancel();
+            TasksFinished(1);
+            return;
+        }
+    }
+
+    // Declared blocking: a spare worker stands in for this one while it runs.
+    bool blocking = task->IsBlocking();
+    if(blocking)
+        BeginBlocking(workerId);
+
+    // Tasks may run nested (a worker helping while it waits), hence restoring the previous one.
+    Task* previousTask = currentTask_;
+    currentTask_ = task;
+    Trace(TRACE_START, task);
+#if THREADPOOL_METRICS
+    uint64_t start = SteadyNanoseconds();
+    task->Execute();
+    WorkerAt(workerId).metrics.RecordTask(task->GetPriority(), start - task->GetEnqueuedAt(), SteadyNanoseconds() - start);
+#else
+    task->Execute();
+#endif
+    Trace(TRACE_END, task);
+    currentTask_ = previousTask;
+    if(blocking)
+        EndBlocking(workerId);
+    TasksFinished(1);
+}
+
+MetricsSnapshot ThreadPool::Snapshot() const {
+    MetricsSnapshot snapshot;
+    snapshot.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    snapshot.pendingTasks = pendingTasks_.load(std::memory_order_relaxed);
+    snapshot.sleepingWorkers = sleepingWorkers_.load(std::memory_order_relaxed);
+    for(std::size_t priority = 0; priority < PRIORITY_CLASSES; priority++)
+        snapshot.queueDepth[priority] = priorityTasks_[priority].load(std::memory_order_relaxed);
+    snapshot.rejectedTasks = rejectedTasks_.load(std::memory_order_relaxed);
+    snapshot.cancelledTasks = cancelledTasks_.load(std::memory_order_relaxed);
+    snapshot.expiredTasks = expiredTasks_.load(std::memory_order_relaxed);
+    snapshot.admittedBytes = admittedBytes_.load(std::memory_order_relaxed);
+    snapshot.blockedWorkers = blockedWorkers_.load(std::memory_order_relaxed);
+    snapshot.spareWorkers = spareWorkers_.load(std::memory_order_relaxed);
+    snapshot.compensations = compensations_.load(std::memory_order_relaxed);
+    std::size_t count = slotCount_.load(std::memory_order_acquire);
+#if THREADPOOL_METRICS
+    Worker** slots = slots_.load(std::memory_order_acquire);
+    for(std::size_t slot = 0; slot < count; slot++)
+        snapshot.workers.push_back(slots[slot]->metrics.Load());
+#else
+    snapshot.workers.resize(count);
+#endif
+    return snapshot;
+}
+
+void ThreadPool::ExportMetrics(MetricsFormat format, const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if(!file)
+        throw std::runtime_error("Can not open metrics file: " + path);
+    file << Snapshot().Format(format);
+}
+
+void ThreadPool::ExportMetrics(MetricsFormat format, const std::function<void(const std::string&)>& sink) const {
+    sink(Snapshot().Format(format));
+}
+
+void ThreadPool::SetTracing(bool enabled) noexcept {
+#if THREADPOOL_TRACING
+    tracing_.store(enabled, std::memory_order_relaxed);
+#else
+    (void)enabled;
+#endif
+}
+
+void ThreadPool::DumpTrace(const std::string& path) const {
+#if THREADPOOL_TRACING
+    std::ofstream file(path, std::ios::trunc);
+    if(!file)
+        throw std::runtime_error("Can not open trace file: " + path);
+    tracer_.Write(file);
+#else
+    (void)path;
+    throw std::logic_error("ThreadPool::DumpTrace(): built without THREADPOOL_TRACING");
+#endif
+}
+
+template<typename Done, typename Block>
+bool ThreadPool::HelpUntil(const Done& done, const Block& block, const TimePoint* deadline) {
+    ThreadPool* pool = currentPool_;
+    int workerId = currentWorker_;
+    unsigned int idleRounds = 0;
+
+    while(!done()){
+        if(deadline && std::chrono::steady_clock::now() >= *deadline)
+            return done();
+
+        if(pool){
+            if(Task* next = pool->NextTask(workerId)){
+                pool->RunTask(next, workerId);
+                idleRounds = 0;
+                continue;
+            }
+        }
+
+        if(!deadline && block(pool != nullptr))
+            continue;
+
+        if(idleRounds++ < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return true;
+}
+
+bool ThreadPool::HelpUntilDone(Task& task, const TimePoint* deadline) {
+    return HelpUntil([&task](){ return task.IsDone(); },
+                     [&task](bool isWorker){
+                         /*
+                          * A pending task is left alone while in a worker, since it may well be
+                          * sitting in a queue this very worker is expected to drain.
+                          */
+                         TaskStatus status = task.GetStatus();
+                         if(status >= STATUS_DONE || (isWorker && status != STATUS_RUNNING))
+                             return false;
+                         task.WaitWhile(status);
+                         return true;
+                     },
+                     deadline);
+}
+
+void ThreadPool::HelpUntilZero(AtomicCounter& counter) {
+    HelpUntil([&counter](){ return counter.load(std::memory_order_acquire) <= 0; },
+              [&counter](bool isWorker){
+                  if(isWorker)
+                      return false;
+                  int64_t value = counter.load(std::memory_order_acquire);
+                  if(value > 0)
+                      counter.wait(value, std::memory_order_acquire);
+                  return true;
+              },
+              nullptr);
+}
+
 /**
- * Threads execute tasks from the queue while the pool is active.
+ * Threads execute tasks while the pool is active.
  *
- * If tasks are available in the queue, a thread will pop a task,
- * execute it and go back to waiting for the next task.
+ * If tasks are available, a thread will take one, execute it and go back
+ * looking for the next one. Only when there is nothing pending anywhere
+ * does it go to sleep on the condition variable.
  */
-void ThreadPool::ExecuteTask() {
-    std::shared_ptr<Task> task;
-    while(poolActive_){
-#ifdef DEBUG
-        std::thread::id threadId = std::this_thread::get_id();
-        int id = threadIdMap_[threadId];
-        std::cout << "Thread checking queue: " << threadId << " associated to: "<< id << std::endl;
+void ThreadPool::ExecuteTask(int workerId) {
+    currentPool_ = this;
+    currentWorker_ = workerId;
+    Worker& worker = WorkerAt(workerId);
+
+    /*
+     * Pinned before anything is allocated from this thread: its slab heap (where the tasks it
+     * spawns live) is first touched here, so Linux places it on the worker's own node. The
+     * deque array was allocated by whoever called StartWorker(), so it is replaced by one
+     * touched here; only once per slot, since a slot always runs on the same CPU. The Worker
+     * itself (and the deque indices in it) stays where it was allocated.
+     */
+    if(worker.cpu >= 0){
+        Topology::PinCurrentThread(worker.cpu);
+        if(!worker.localized){
+            worker.tasks.Localize();
+            worker.localized = true;
+        }
+    }
+
+    while(poolActive_ && !worker.retiring){
+        if(Task* task = NextTask(workerId)){
+            RunTask(task, workerId);
+            continue;
+        }
+
+#if THREADPOOL_METRICS
+        uint64_t idleStart = SteadyNanoseconds();
+#endif
+        if(Task* task = SpinForTask(workerId)){
+#if THREADPOOL_METRICS
+            WorkerMetrics::Add(worker.metrics.idleTime, SteadyNanoseconds() - idleStart);
 #endif
+            RunTask(task, workerId);
+            continue;
+        }
+
+        bool woken;
+        Trace(TRACE_PARK, nullptr);
         {
+            auto wakeUp = [this, &worker](){
+                return pendingTasks_ > 0 || !poolActive_ || worker.retiring;
+            };
             UniqueLock lock(mutex_);
-            cv_.wait(lock, MutexLockPredicate(tasks_, poolActive_));
-            if(!tasks_.empty()){
-                task = std::move(tasks_.front());
-                tasks_.pop();
-                task->AssociateThread(threadIdMap_[std::this_thread::get_id()]);
-                lock.unlock();
-                task->Execute();
+            sleepingWorkers_++;
+            if(elastic_)
+                woken = cv_.wait_for(lock, idleTimeout_, wakeUp);
+            else {
+                cv_.wait(lock, wakeUp);
+                woken = true;
             }
+            sleepingWorkers_--;
         }
+        Trace(TRACE_UNPARK, nullptr);
+#if THREADPOOL_METRICS
+        WorkerMetrics::Add(worker.metrics.idleTime, SteadyNanoseconds() - idleStart);
+#endif
+        if(!woken)
+            TryRetire(worker);
     }
+
+    // Retired: nobody else pushes into this deque, run what is left in it before leaving.
+    while(poolActive_){
+        Task* task = worker.tasks.Pop();
+        if(!task)
+            break;
+        Trace(TRACE_DEQUEUE, task);
+        pendingTasks_--;
+        if(admissionControl_)
+            Discharge(task);
+        RunTask(task, workerId);
+    }
+
+    currentPool_ = nullptr;
+    currentWorker_ = -1;
+    worker.exited = true;
 }
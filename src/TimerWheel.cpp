@@ -0,0 +1,144 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <bit>
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(uint64_t now) : now_(now) {
+    for(Entry& head : heads_){
+        head.prev = &head;
+        head.next = &head;
+    }
+}
+
+std::size_t TimerWheel::SlotFor(uint64_t expiry) const noexcept {
+    // The lowest level above which the expiry and the current time agree.
+    uint64_t diff = expiry ^ now_;
+    std::size_t level = diff == 0 ? 0 : static_cast<std::size_t>(std::bit_width(diff) - 1) / LEVEL_BITS;
+    if(level >= LEVELS)
+        return OVERFLOW_SLOT;
+    return level * SLOTS + ((expiry >> (LEVEL_BITS * level)) & (SLOTS - 1));
+}
+
+void TimerWheel::Link(Entry* entry, std::size_t slot) noexcept {
+    Entry& head = heads_[slot];
+    entry->prev = head.prev;
+    entry->next = &head;
+    head.prev->next = entry;
+    head.prev = entry;
+    entry->slot = slot;
+    if(slot != OVERFLOW_SLOT)
+        occupied_[slot / SLOTS] |= uint64_t(1) << (slot % SLOTS);
+}
+
+void TimerWheel::Unlink(Entry* entry) noexcept {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = nullptr;
+    entry->next = nullptr;
+
+    Entry& head = heads_[entry->slot];
+    if(head.next == &head && entry->slot != OVERFLOW_SLOT)
+        occupied_[entry->slot / SLOTS] &= ~(uint64_t(1) << (entry->slot % SLOTS));
+}
+
+void TimerWheel::Insert(Entry* entry, uint64_t expiry) noexcept {
+    entry->expiry = expiry > now_ ? expiry : now_ + 1;
+    Link(entry, SlotFor(entry->expiry));
+    size_++;
+}
+
+void TimerWheel::Remove(Entry* entry) noexcept {
+    Unlink(entry);
+    size_--;
+}
+
+uint64_t TimerWheel::NextEvent() const noexcept {
+    /*
+     * Anything in a level happens before the next turn of the level above, so the first
+     * level with a slot in use ahead of the current one has the answer.
+     */
+    for(std::size_t level = 0; level < LEVELS; level++){
+        unsigned shift = LEVEL_BITS * static_cast<unsigned>(level);
+        uint64_t index = (now_ >> shift) & (SLOTS - 1);
+        uint64_t ahead = index == SLOTS - 1 ? 0 : occupied_[level] & (~uint64_t(0) << (index + 1));
+        if(ahead){
+            uint64_t span = uint64_t(1) << (shift + LEVEL_BITS);
+            return (now_ & ~(span - 1)) | (static_cast<uint64_t>(std::countr_zero(ahead)) << shift);
+        }
+    }
+
+    const Entry& overflow = heads_[OVERFLOW_SLOT];
+    if(overflow.next != &overflow)
+        return (now_ | (WHEEL_SPAN - 1)) + 1;
+    return NEVER;
+}
+
+void TimerWheel::Cascade(std::size_t slot) noexcept {
+    Entry& head = heads_[slot];
+    Entry* entry = head.next;
+    head.prev = &head;
+    head.next = &head;
+    if(slot != OVERFLOW_SLOT)
+        occupied_[slot / SLOTS] &= ~(uint64_t(1) << (slot % SLOTS));
+
+    while(entry != &head){
+        Entry* next = entry->next;
+        Link(entry, SlotFor(entry->expiry));
+        entry = next;
+    }
+}
+
+void TimerWheel::Advance(uint64_t tick, std::vector<Entry*>& expired) {
+    while(now_ < tick){
+        uint64_t next = NextEvent();
+        if(next > tick){
+            now_ = tick;
+            break;
+        }
+        now_ = next;
+
+        // Top level first, so that entries can go down several levels within the same tick.
+        if((now_ & (WHEEL_SPAN - 1)) == 0)
+            Cascade(OVERFLOW_SLOT);
+        for(std::size_t level = LEVELS - 1; level > 0; level--){
+            unsigned shift = LEVEL_BITS * static_cast<unsigned>(level);
+            if((now_ & ((uint64_t(1) << shift) - 1)) == 0)
+                Cascade(level * SLOTS + ((now_ >> shift) & (SLOTS - 1)));
+        }
+
+        Entry& head = heads_[now_ & (SLOTS - 1)];
+        while(head.next != &head){
+            Entry* entry = head.next;
+            Remove(entry);
+            expired.push_back(entry);
+        }
+    }
+}
+
+void TimerWheel::Clear(std::vector<Entry*>& entries) {
+    for(Entry& head : heads_){
+        while(head.next != &head){
+            Entry* entry = head.next;
+            Remove(entry);
+            entries.push_back(entry);
+        }
+    }
+}
@@ -0,0 +1,208 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <tuple>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "Topology.h"
+
+namespace {
+    const std::string CPU_PATH = "/sys/devices/system/cpu/";
+    const std::string NODE_PATH = "/sys/devices/system/node/";
+
+    std::string ReadLine(const std::string& path){
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    int ReadInt(const std::string& path, int fallback){
+        std::string line = ReadLine(path);
+        try {
+            return line.empty() ? fallback : std::stoi(line);
+        } catch(const std::exception&) {
+            return fallback;
+        }
+    }
+
+    // Id of the level 3 cache of a CPU, looked up among its cache indices.
+    int ReadL3(int cpu){
+        std::string base = CPU_PATH + "cpu" + std::to_string(cpu) + "/cache/";
+        for(int index = 0; index < 8; index++){
+            std::string cache = base + "index" + std::to_string(index) + "/";
+            if(ReadInt(cache + "level", -1) != 3)
+                continue;
+            int id = ReadInt(cache + "id", -1);
+            if(id >= 0)
+                return id;
+            // Older kernels have no id: the first CPU sharing the cache identifies it.
+            std::vector<int> shared = Topology::ParseCpuList(ReadLine(cache + "shared_cpu_list"));
+            return shared.empty() ? -1 : shared.front();
+        }
+        return -1;
+    }
+}
+
+std::vector<int> Topology::ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while(std::getline(stream, range, ',')){
+        try {
+            std::size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for(int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        } catch(const std::exception&) {
+            // Malformed range, skipped.
+        }
+    }
+    return cpus;
+}
+
+Topology Topology::Detect() {
+    Topology topology;
+
+    std::vector<int> online = ParseCpuList(ReadLine(CPU_PATH + "online"));
+    if(online.empty()){
+        for(unsigned int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+            online.push_back(static_cast<int>(cpu));
+    }
+
+#ifdef __linux__
+    // CPUs outside the process' affinity mask can not run workers: pinning to them would fail.
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0){
+        std::vector<int> usable;
+        for(int cpu : online){
+            if(cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                usable.push_back(cpu);
+        }
+        if(!usable.empty())
+            online = std::move(usable);
+    }
+#endif
+
+    for(int cpu : online){
+        std::string path = CPU_PATH + "cpu" + std::to_string(cpu) + "/topology/";
+        topology.cpus_.push_back(Cpu{cpu, ReadInt(path + "core_id", cpu), ReadInt(path + "physical_package_id", 0), 0, ReadL3(cpu)});
+    }
+
+    std::error_code error;
+    int maxNode = 0;
+    for(const auto& entry : std::filesystem::directory_iterator(NODE_PATH, error)){
+        std::string name = entry.path().filename().string();
+        if(name.rfind("node", 0) != 0 || name.size() == 4 || !std::isdigit(static_cast<unsigned char>(name[4])))
+            continue;
+        int node = std::stoi(name.substr(4));
+        for(int cpu : ParseCpuList(ReadLine(entry.path().string() + "/cpulist"))){
+            auto it = std::find_if(topology.cpus_.begin(), topology.cpus_.end(), [cpu](const Cpu& c){ return c.id == cpu; });
+            if(it != topology.cpus_.end()){
+                it->node = node;
+                maxNode = std::max(maxNode, node);
+            }
+        }
+    }
+    topology.nodeCount_ = static_cast<std::size_t>(maxNode) + 1;
+
+    return topology;
+}
+
+const Topology::Cpu* Topology::Find(int cpu) const noexcept {
+    auto it = std::find_if(cpus_.begin(), cpus_.end(), [cpu](const Cpu& c){ return c.id == cpu; });
+    return it != cpus_.end() ? &*it : nullptr;
+}
+
+std::vector<int> Topology::PlacementOrder(AffinityPolicy policy, const std::vector<int>& explicitCpus) const {
+    std::vector<int> order;
+
+    if(policy == AFFINITY_EXPLICIT){
+        for(int cpu : explicitCpus){
+            if(Find(cpu))
+                order.push_back(cpu);
+        }
+        return order;
+    }
+    if(policy == AFFINITY_NONE)
+        return order;
+
+    std::vector<Cpu> sorted = cpus_;
+    std::sort(sorted.begin(), sorted.end(), [](const Cpu& a, const Cpu& b){
+        return std::tie(a.node, a.package, a.l3, a.core, a.id) < std::tie(b.node, b.package, b.l3, b.core, b.id);
+    });
+
+    if(policy == AFFINITY_COMPACT){
+        for(const Cpu& cpu : sorted)
+            order.push_back(cpu.id);
+        return order;
+    }
+
+    /*
+     * Scatter: within every node, one CPU per core first and SMT siblings afterwards;
+     * then the nodes are interleaved.
+     */
+    std::map<int, std::vector<int>> perNode;
+    std::map<std::pair<int, int>, int> siblings;
+    std::vector<std::pair<int, const Cpu*>> ranked;
+    for(const Cpu& cpu : sorted)
+        ranked.emplace_back(siblings[{cpu.package, cpu.core}]++, &cpu);
+    std::stable_sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b){
+        return std::tie(a.second->node, a.first) < std::tie(b.second->node, b.first);
+    });
+    for(const auto& [rank, cpu] : ranked)
+        perNode[cpu->node].push_back(cpu->id);
+
+    for(std::size_t i = 0; order.size() < sorted.size(); i++){
+        for(const auto& [node, cpus] : perNode){
+            if(i < cpus.size())
+                order.push_back(cpus[i]);
+        }
+    }
+    return order;
+}
+
+bool Topology::PinCurrentThread(int cpu) noexcept {
+#ifdef __linux__
+    if(cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
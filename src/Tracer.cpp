@@ -0,0 +1,184 @@
+/*
+ * This file is part of the ThreadPoolLib project.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @author - Geru-Scotland (https://github.com/geru-scotland)
+ */
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iomanip>
+#include "Tracer.h"
+
+namespace {
+    std::atomic<uint64_t> nextTracerId{1};
+
+    struct RawEvent {
+        uint64_t timestamp;
+        uint64_t id;
+        const char* name;
+        uint32_t type;
+    };
+
+    // Chrome trace timestamps are in microseconds; nanoseconds go after the decimal point.
+    void WriteTimestamp(std::ostream& out, uint64_t nanoseconds){
+        out << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000;
+    }
+
+    void WriteString(std::ostream& out, const char* text){
+        out << '"';
+        for(const char* c = text; *c; c++){
+            if(*c == '"' || *c == '\\')
+                out << '\\' << *c;
+            else if(static_cast<unsigned char>(*c) < 0x20)
+                out << ' ';
+            else
+                out << *c;
+        }
+        out << '"';
+    }
+}
+
+thread_local Tracer::BufferCache Tracer::cache_{0, nullptr};
+
+Tracer::Tracer(std::size_t capacity)
+    : id_(nextTracerId.fetch_add(1, std::memory_order_relaxed)),
+      mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1) {}
+
+uint64_t Tracer::Now() noexcept {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+Tracer::Buffer* Tracer::AddBuffer(int workerId) {
+    std::thread::id threadId = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Buffer* buffer = nullptr;
+    for(const std::unique_ptr<Buffer>& candidate : buffers_){
+        if(candidate->owner == threadId){
+            buffer = candidate.get();
+            break;
+        }
+    }
+
+    if(!buffer){
+        buffers_.emplace_back(std::make_unique<Buffer>());
+        buffer = buffers_.back().get();
+        buffer->owner = threadId;
+        buffer->worker = workerId;
+        buffer->events = std::make_unique<Event[]>(mask_ + 1);
+    }
+
+    cache_ = BufferCache{id_, buffer};
+    return buffer;
+}
+
+void Tracer::Write(std::ostream& out) const {
+    std::vector<Buffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(const std::unique_ptr<Buffer>& buffer : buffers_)
+            buffers.push_back(buffer.get());
+    }
+
+    const uint64_t capacity = mask_ + 1;
+    std::vector<RawEvent> events;
+    bool first = true;
+    auto separator = [&out, &first]() -> std::ostream& {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        return out;
+    };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    separator() << R"({"ph":"M","pid":1,"tid":0,"name":"process_name","args":{"name":"ThreadPool"}})";
+
+    for(std::size_t track = 0; track < buffers.size(); track++){
+        const Buffer& buffer = *buffers[track];
+        std::size_t tid = track + 1;
+
+        // Whatever the owner claimed meanwhile may have been overwritten while being copied.
+        uint64_t end = buffer.written.load(std::memory_order_acquire);
+        uint64_t begin = end > capacity ? end - capacity : 0;
+        events.clear();
+        for(uint64_t index = begin; index < end; index++){
+            const Event& event = buffer.events[index & mask_];
+            events.push_back(RawEvent{event.timestamp.load(std::memory_order_relaxed),
+                                      event.id.load(std::memory_order_relaxed),
+                                      event.name.load(std::memory_order_relaxed),
+                                      event.type.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t claimed = buffer.claimed.load(std::memory_order_relaxed);
+        std::size_t stale = claimed > capacity + begin ? static_cast<std::size_t>(claimed - capacity - begin) : 0;
+        events.erase(events.begin(), events.begin() + static_cast<std::ptrdiff_t>(std::min(stale, events.size())));
+
+        int worker = buffer.worker;
+        separator() << R"({"ph":"M","pid":1,"tid":)" << tid << R"(,"name":"thread_name","args":{"name":")"
+                    << (worker >= 0 ? "worker " : "thread ") << (worker >= 0 ? static_cast<std::size_t>(worker) : tid) << "\"}}";
+
+        // Slices whose beginning was overwritten can not be closed.
+        std::size_t depth = 0;
+        for(const RawEvent& event : events){
+            const char* name = event.name ? event.name : "task";
+            switch(event.type){
+                case TRACE_ENQUEUE:
+                    separator() << R"({"ph":"X","pid":1,"tid":)" << tid << R"(,"dur":0,"name":"enqueue","ts":)";
+                    WriteTimestamp(out, event.timestamp);
+                    out << R"(,"args":{"task":)";
+                    WriteString(out, name);
+                    out << "}}";
+                    separator() << R"({"ph":"s","pid":1,"tid":)" << tid << R"(,"cat":"task","name":"queued","id":)" << event.id << R"(,"ts":)";
+                    WriteTimestamp(out, event.timestamp);
+                    out << "}";
+                    break;
+                case TRACE_DEQUEUE:
+                    separator() << R"({"ph":"i","s":"t","pid":1,"tid":)" << tid << R"(,"name":"dequeue","ts":)";
+                    WriteTimestamp(out, event.timestamp);
+                    out << "}";
+                    break;
+                case TRACE_START:
+                case TRACE_PARK:
+                    separator() << R"({"ph":"B","pid":1,"tid":)" << tid << R"(,"name":)";
+                    WriteString(out, event.type == TRACE_PARK ? "parked" : name);
+                    out << R"(,"ts":)";
+                    WriteTimestamp(out, event.timestamp);
+                    out << "}";
+                    if(event.type == TRACE_START){
+                        separator() << R"({"ph":"f","bp":"e","pid":1,"tid":)" << tid << R"(,"cat":"task","name":"queued","id":)" << event.id << R"(,"ts":)";
+                        WriteTimestamp(out, event.timestamp);
+                        out << "}";
+                    }
+                    depth++;
+                    break;
+                case TRACE_END:
+                case TRACE_UNPARK:
+                    if(depth == 0)
+                        break;
+                    separator() << R"({"ph":"E","pid":1,"tid":)" << tid << R"(,"ts":)";
+                    WriteTimestamp(out, event.timestamp);
+                    out << "}";
+                    depth--;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    out << "\n]}\n";
+}